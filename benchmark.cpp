@@ -0,0 +1,558 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "benchmark.h"
+
+#if defined(__linux__) && !defined(PICOLAN_NODE_BINDING)
+
+#include <stdio.h>
+#include "picolan.h"
+#include "histogram.h"
+
+namespace picolan
+{
+
+namespace
+{
+
+const uint8_t SERVER_PORT = 10;
+const uint8_t CLIENT_PORT = 20;
+const uint8_t DATAGRAM_PORT = 30;
+
+// nodes wait this long before starting, so the switches have learnt where they are
+const uint32_t WARMUP_MS = 300;
+
+// how long a test may run for before it is abandoned
+const uint32_t LIMIT_MS = 10*60*1000;
+
+std::string number(double v)
+{
+	char s[32];
+	snprintf(s, sizeof(s), "%.6g", v);
+	return s;
+}
+
+void field(std::string& out, const char* name, const std::string& value)
+{
+	out += ", \"";
+	out += name;
+	out += "\": ";
+	out += value;
+}
+
+void field(std::string& out, const char* name, double value)
+{
+	field(out, name, number(value));
+}
+
+// a stream with a send buffer takes what fits and returns, so wait for room as an application would
+int write_all(Interface& iface, SocketStream& s, uint8_t* data, uint32_t len)
+{
+	uint32_t sent = 0;
+	while(sent < len) {
+		int r = s.write(data+sent, len-sent);
+		if(r < 0) {
+			return r;
+		}
+		if(r == 0) {
+			if(!s.connected()) {
+				return Error::BAD_STATE;
+			}
+			iface.service();
+		}
+		sent += r;
+	}
+	return sent;
+}
+
+std::string quote(const std::string& s)
+{
+	std::string out = "\"";
+	for(char c : s) {
+		if((c == '"') || (c == '\\')) {
+			out += '\\';
+		}
+		if((uint8_t)c >= 0x20) {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+}
+
+Benchmark::Benchmark(const BenchParams& p) : params(p)
+{
+	if(params.link.baud == 0) {
+		params.link.baud = LinkParams().baud;
+	}
+}
+
+void Benchmark::build(Simulator& sim, const Case& c, SimEndpoint*& a, SimEndpoint*& b)
+{
+	LinkParams link = params.link;
+	link.loss = c.loss;
+
+	// the switches form a chain with a node at each end
+	SoftSwitch* prev = nullptr;
+	for(uint8_t i = 0; i < c.hops; i++) {
+		SoftSwitch& sw = sim.add_switch();
+		sw.set_refresh(WARMUP_MS/3);
+		if(prev == nullptr) {
+			a = &sim.attach(sw, link);
+		} else {
+			sim.connect(*prev, sw, link);
+		}
+		prev = &sw;
+	}
+	b = &sim.attach(*prev, link);
+}
+
+std::string Benchmark::run(const std::string& label)
+{
+	std::string out = "{\n  \"label\": " + quote(label) + ",\n  \"link\": {\"baud\": ";
+	out += number(params.link.baud);
+	field(out, "delay_us", params.link.delay_us);
+	field(out, "bit_error_rate", params.link.bit_error_rate);
+	field(out, "reorder", params.link.reorder);
+	field(out, "depth", params.link.depth);
+	out += "},\n  \"results\": [";
+
+	bool first = true;
+	auto add = [&](const std::string& result) {
+		out += first ? "\n    " : ",\n    ";
+		out += result;
+		first = false;
+	};
+
+	for(uint8_t hops : params.hops) {
+		for(double loss : params.losses) {
+			for(uint32_t payload : params.payloads) {
+				Case c = {payload, loss, hops};
+				add(datagram(c));
+				add(stream(c, false));
+				add(latency(c));
+			}
+			// a send buffer takes writes of any size, so this doesn't depend on the payload
+			Case c = {0, loss, hops};
+			add(stream(c, true));
+			add(connect(c));
+		}
+	}
+	out += "\n  ]\n}\n";
+	return out;
+}
+
+bool Benchmark::write(const std::string& path, const std::string& label)
+{
+	std::string json = run(label);
+	FILE* f = fopen(path.c_str(), "w");
+	if(f == nullptr) {
+		return false;
+	}
+	bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+	return (fclose(f) == 0) && ok;
+}
+
+static std::string head(const char* test, uint32_t payload, double loss, uint8_t hops)
+{
+	std::string out = "{\"test\": \"";
+	out += test;
+	out += "\"";
+	field(out, "payload", payload);
+	field(out, "loss", loss);
+	field(out, "hops", hops);
+	return out;
+}
+
+std::string Benchmark::datagram(const Case& c)
+{
+	Simulator sim(params.seed);
+	SimEndpoint* a;
+	SimEndpoint* b;
+	build(sim, c, a, b);
+
+	const uint64_t start = (uint64_t)WARMUP_MS*1000;
+	const uint64_t end = start + (uint64_t)params.duration_ms*1000;
+	const uint32_t frames_per_write = (c.payload + MAX_DATAGRAM_PAYLOAD - 1)/MAX_DATAGRAM_PAYLOAD;
+	uint32_t tx_frames = 0;
+	uint64_t tx_end = start;
+	uint32_t rx_frames = 0;
+	uint64_t rx_bytes = 0;
+	uint64_t rx_end = start;
+
+	sim.spawn([&]() {
+		Interface iface(*a);
+		iface.set_address(1);
+		std::vector<uint8_t> buf(256);
+		Datagram dg(buf.data(), buf.size(), DATAGRAM_PORT);
+		iface.bind(dg);
+		std::vector<uint8_t> data(c.payload, 0x55);
+
+		sim.sleep_ms(WARMUP_MS);
+		while(sim.now_us() < end) {
+			dg.write(2, DATAGRAM_PORT, data.data(), data.size());
+			tx_frames += frames_per_write;
+			iface.service();
+		}
+		tx_end = sim.now_us();
+	});
+
+	sim.spawn([&]() {
+		Interface iface(*b);
+		iface.set_address(2);
+		std::vector<uint8_t> buf(4096);
+		Datagram dg(buf.data(), buf.size(), DATAGRAM_PORT);
+		iface.bind(dg);
+
+		sim.sleep_ms(WARMUP_MS);
+		dg.reset_stats();
+		// frames still on their way at the end are counted, and the receive rate
+		// is taken over the time from the first write to the last frame delivered
+		uint64_t stop = end + (uint64_t)params.timeout_ms*1000;
+		uint8_t x[256];
+		while(sim.now_us() < stop) {
+			iface.service();
+			uint32_t frames = dg.get_stats().rx_frames;
+			if(frames != rx_frames) {
+				rx_frames = frames;
+				rx_end = sim.now_us();
+			}
+			uint32_t n = dg.available();
+			if(n > sizeof(x)) {
+				n = sizeof(x);
+			}
+			if(n != 0) {
+				rx_bytes += dg.read(x, n);
+			}
+		}
+	});
+
+	sim.run_for(LIMIT_MS);
+
+	double tx_secs = (tx_end - start)/1e6;
+	double rx_secs = (rx_end - start)/1e6;
+	std::string out = head("datagram", c.payload, c.loss, c.hops);
+	field(out, "tx_frames_per_sec", (tx_secs > 0) ? tx_frames/tx_secs : 0);
+	field(out, "rx_frames_per_sec", (rx_secs > 0) ? rx_frames/rx_secs : 0);
+	field(out, "goodput_bps", (rx_secs > 0) ? rx_bytes*8/rx_secs : 0);
+	return out + "}";
+}
+
+std::string Benchmark::stream(const Case& c, bool buffered)
+{
+	Simulator sim(params.seed);
+	SimEndpoint* a;
+	SimEndpoint* b;
+	build(sim, c, a, b);
+
+	int error = Error::NONE;
+	uint64_t started = 0;
+	uint64_t finished = 0;
+
+	sim.spawn([&]() {
+		Interface iface(*a);
+		iface.set_address(1);
+		std::vector<uint8_t> rx(256);
+		std::vector<uint8_t> tx(4096);
+		Client client(rx.data(), rx.size(), CLIENT_PORT);
+		iface.bind(client);
+		if(buffered) {
+			client.set_send_buffer(tx.data(), tx.size());
+		}
+		client.set_timeout(params.timeout_ms);
+		// without a send buffer each write waits for its ACK, so the payload sets the pace
+		uint32_t chunk = buffered ? tx.size() : c.payload;
+		std::vector<uint8_t> data(chunk, 0x55);
+
+		sim.sleep_ms(WARMUP_MS);
+		int r = client.connect(2, SERVER_PORT);
+		if(r != Error::NONE) {
+			error = r;
+			return;
+		}
+		started = sim.now_us();
+		uint32_t sent = 0;
+		while((sent < params.stream_bytes) && (error == Error::NONE)) {
+			uint32_t n = params.stream_bytes - sent;
+			if(n > chunk) {
+				n = chunk;
+			}
+			r = write_all(iface, client, data.data(), n);
+			if(r < 0) {
+				error = r;
+				return;
+			}
+			sent += r;
+		}
+		client.flush();
+		while((finished == 0) && (error == Error::NONE)) {
+			iface.service();
+		}
+		client.disconnect();
+	});
+
+	sim.spawn([&]() {
+		Interface iface(*b);
+		iface.set_address(2);
+		std::vector<uint8_t> rx(8192);
+		Server server(rx.data(), rx.size(), SERVER_PORT);
+		iface.bind(server);
+		server.set_timeout(params.timeout_ms);
+		server.listen();
+
+		uint64_t deadline = (uint64_t)(WARMUP_MS + 2*params.timeout_ms)*1000;
+		while(!server.connection_pending() && (error == Error::NONE)) {
+			if(sim.now_us() > deadline) {
+				error = Error::TIMEOUT;
+				return;
+			}
+			iface.service();
+		}
+		if(error != Error::NONE) {
+			return;
+		}
+		int r = server.accept();
+		if(r != Error::NONE) {
+			error = r;
+			return;
+		}
+
+		uint8_t x[1024];
+		uint32_t got = 0;
+		while(got < params.stream_bytes) {
+			uint32_t n = params.stream_bytes - got;
+			if(n > sizeof(x)) {
+				n = sizeof(x);
+			}
+			// a lost frame is only sent again after the timeout, so one empty read isn't fatal.
+			// read() closes the connection when the client has really gone.
+			r = server.read(x, n);
+			if((r < 0) || !server.connected()) {
+				error = (r < 0) ? r : Error::TIMEOUT;
+				return;
+			}
+			got += r;
+		}
+		finished = sim.now_us();
+	});
+
+	sim.run_for(LIMIT_MS);
+
+	std::string out = head(buffered ? "stream_buffered" : "stream", c.payload, c.loss, c.hops);
+	if((error != Error::NONE) || (finished == 0)) {
+		field(out, "error", (error != Error::NONE) ? error : Error::TIMEOUT);
+		return out + "}";
+	}
+	double secs = (finished - started)/1e6;
+	field(out, "bytes", params.stream_bytes);
+	field(out, "seconds", secs);
+	field(out, "goodput_bps", params.stream_bytes*8/secs);
+	return out + "}";
+}
+
+std::string Benchmark::latency(const Case& c)
+{
+	Simulator sim(params.seed);
+	SimEndpoint* a;
+	SimEndpoint* b;
+	build(sim, c, a, b);
+
+	const uint64_t end = (uint64_t)(WARMUP_MS + params.duration_ms)*1000;
+	int error = Error::NONE;
+	bool done = false;
+	uint32_t failed = 0;
+	Histogram rtt;
+
+	sim.spawn([&]() {
+		Interface iface(*a);
+		iface.set_address(1);
+		std::vector<uint8_t> rx(4096);
+		std::vector<uint8_t> tx(4096);
+		Client client(rx.data(), rx.size(), CLIENT_PORT);
+		iface.bind(client);
+		client.set_send_buffer(tx.data(), tx.size());
+		client.set_timeout(params.timeout_ms);
+		std::vector<uint8_t> request(c.payload, 0x55);
+		std::vector<uint8_t> response(c.payload);
+
+		sim.sleep_ms(WARMUP_MS);
+		while(sim.now_us() < end) {
+			// a failed request leaves part of a response in flight, so start a new connection
+			if(!client.connected()) {
+				client.disconnect();
+				error = client.connect(2, SERVER_PORT);
+				if(error != Error::NONE) {
+					failed++;
+					continue;
+				}
+			}
+			uint64_t t = sim.now_us();
+			if(write_all(iface, client, request.data(), request.size()) < 0) {
+				failed++;
+				client.disconnect();
+				continue;
+			}
+			// a lost frame is sent again after the timeout, so allow the response that long again
+			uint64_t deadline = t + (uint64_t)2*params.timeout_ms*1000;
+			uint32_t got = 0;
+			while((got < response.size()) && client.connected() && (sim.now_us() < deadline)) {
+				int r = client.read(response.data()+got, response.size()-got);
+				if(r > 0) {
+					got += r;
+				}
+			}
+			if(got != response.size()) {
+				failed++;
+				client.disconnect();
+				continue;
+			}
+			rtt.record(sim.now_us() - t);
+		}
+		done = true;
+		client.disconnect();
+	});
+
+	sim.spawn([&]() {
+		Interface iface(*b);
+		iface.set_address(2);
+		std::vector<uint8_t> rx(8192);
+		std::vector<uint8_t> tx(4096);
+		Server server(rx.data(), rx.size(), SERVER_PORT);
+		iface.bind(server);
+		server.set_send_buffer(tx.data(), tx.size());
+		server.set_timeout(params.timeout_ms);
+
+		while(!done) {
+			server.listen();
+			while(!server.connection_pending() && !done) {
+				iface.service();
+			}
+			if(done || (server.accept() != Error::NONE)) {
+				continue;
+			}
+
+			// echo every request until the client goes away. A client that vanishes without
+			// hanging up is dropped by read() after a few timeouts with nothing received.
+			std::vector<uint8_t> request(c.payload);
+			while(!done && server.connected()) {
+				int r = server.read(request.data(), request.size());
+				if(r > 0) {
+					write_all(iface, server, request.data(), r);
+				}
+			}
+			server.disconnect();
+		}
+	});
+
+	sim.run_for(LIMIT_MS);
+
+	std::string out = head("latency", c.payload, c.loss, c.hops);
+	if(rtt.count() == 0) {
+		field(out, "error", (error != Error::NONE) ? error : Error::TIMEOUT);
+		return out + "}";
+	}
+	field(out, "requests", rtt.count());
+	field(out, "failed", failed);
+	field(out, "failure_rate", (double)failed/(rtt.count() + failed));
+	field(out, "mean_us", rtt.mean());
+	field(out, "p50_us", rtt.percentile(50));
+	field(out, "p99_us", rtt.percentile(99));
+	field(out, "max_us", rtt.max());
+	return out + "}";
+}
+
+std::string Benchmark::connect(const Case& c)
+{
+	Simulator sim(params.seed);
+	SimEndpoint* a;
+	SimEndpoint* b;
+	build(sim, c, a, b);
+
+	const uint64_t end = (uint64_t)(WARMUP_MS + params.duration_ms)*1000;
+	uint32_t connects = 0;
+	uint32_t failed = 0;
+	bool done = false;
+
+	sim.spawn([&]() {
+		Interface iface(*a);
+		iface.set_address(1);
+		std::vector<uint8_t> rx(256);
+		Client client(rx.data(), rx.size(), CLIENT_PORT);
+		iface.bind(client);
+		client.set_timeout(params.timeout_ms);
+
+		sim.sleep_ms(WARMUP_MS);
+		while(sim.now_us() < end) {
+			if(client.connect(2, SERVER_PORT) == Error::NONE) {
+				connects++;
+			} else {
+				failed++;
+			}
+			client.disconnect();
+		}
+		done = true;
+	});
+
+	sim.spawn([&]() {
+		Interface iface(*b);
+		iface.set_address(2);
+		std::vector<uint8_t> rx(256);
+		Server server(rx.data(), rx.size(), SERVER_PORT);
+		iface.bind(server);
+		server.set_timeout(params.timeout_ms);
+
+		while(!done) {
+			server.listen();
+			while(!server.connection_pending() && !done) {
+				iface.service();
+			}
+			if(done || (server.accept() != Error::NONE)) {
+				continue;
+			}
+			// a lost hang up would leave the server stuck, so give up on the client in time
+			uint64_t deadline = sim.now_us() + (uint64_t)params.timeout_ms*1000;
+			while(!server.closed() && !done && (sim.now_us() < deadline)) {
+				iface.service();
+			}
+			server.disconnect();
+		}
+	});
+
+	sim.run_for(LIMIT_MS);
+
+	double secs = params.duration_ms/1000.0;
+	std::string out = head("connect", c.payload, c.loss, c.hops);
+	field(out, "connects", connects);
+	field(out, "failed", failed);
+	field(out, "connects_per_sec", connects/secs);
+	return out + "}";
+}
+
+}
+
+#endif
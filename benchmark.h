@@ -0,0 +1,135 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_BENCHMARK_H
+#define PICOLAN_BENCHMARK_H
+
+#if defined(__linux__) && !defined(PICOLAN_NODE_BINDING)
+
+#include <string>
+#include <vector>
+#include "simulator.h"
+
+namespace picolan
+{
+
+	/**
+	 * BenchParams chooses what a Benchmark sweeps over.
+	 */
+	struct BenchParams
+	{
+		/** the bytes passed to each write or request. The buffered stream test ignores it. */
+		std::vector<uint32_t> payloads = {8, 32, 54, 256, 1024};
+
+		/** the frame loss on every link */
+		std::vector<double> losses = {0, 0.001, 0.01};
+
+		/** the number of switches between the two nodes */
+		std::vector<uint8_t> hops = {1, 2};
+
+		/**
+		 * Every link is made from this, with the loss from the sweep. Its baud rate paces the
+		 * senders, so it can't be zero.
+		 */
+		LinkParams link;
+
+		/** the virtual time the datagram, latency and connect tests each run for */
+		uint32_t duration_ms = 10000;
+
+		/** the bytes the stream test sends */
+		uint32_t stream_bytes = 32768;
+
+		/** the socket timeout, which is how long a test waits on a lost frame */
+		uint32_t timeout_ms = 2000;
+
+		uint32_t seed = 1;
+	};
+
+
+	/**
+	 * Benchmark measures the transport layer end to end, in the manner of iperf, so changes to
+	 * the protocol can be compared between commits by numbers rather than by feel.
+	 *
+	 * For every combination of payload size, loss and hop count it measures:
+	 * - datagram: frames a second sent, and delivered to the receiving socket, and goodput of
+	 *   back to back Datagram::write() calls
+	 * - stream: goodput of a bulk transfer from a Client to a Server, written in payload sized
+	 *   writes without a send buffer so each write waits for its ACK
+	 * - stream_buffered: the same transfer through a send buffer, once per loss and hop count.
+	 *   The buffer takes writes of any size, so the payload makes no difference here
+	 * - latency: round trip times of requests echoed by a Server. A request that fails is counted
+	 *   and the client connects again, so the test always runs for its whole duration
+	 * - connect: Client::connect() and Server::accept() pairs a second, once per loss and hop count
+	 *
+	 * Each measurement runs in a fresh Simulator, so the results only depend on the protocol
+	 * and the parameters. They are repeatable, and don't depend on the machine running them.
+	 * A test that fails reports the error code instead of its numbers.
+	 * The benchmark isn't part of the node binding.
+	 *
+	 * tools/picolan_bench.cpp runs it from the command line, taking the output path and label.
+	 */
+	class Benchmark
+	{
+		public:
+			Benchmark(const BenchParams& params = BenchParams());
+
+			/**
+			 * \brief runs every test.
+			 * @param label identifies the run in the results, such as a commit hash
+			 * \return the results as JSON
+			 */
+			std::string run(const std::string& label = "");
+
+			/**
+			 * \brief runs every test and writes the JSON results to a file.
+			 * \return false if the file couldn't be written
+			 */
+			bool write(const std::string& path, const std::string& label = "");
+
+		private:
+			struct Case
+			{
+				uint32_t payload;
+				double loss;
+				uint8_t hops;
+			};
+
+			void build(Simulator& sim, const Case& c, SimEndpoint*& a, SimEndpoint*& b);
+
+			std::string datagram(const Case& c);
+			std::string stream(const Case& c, bool buffered);
+			std::string latency(const Case& c);
+			std::string connect(const Case& c);
+
+			BenchParams params;
+	};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "bond_transport.h"
+
+#ifndef ARDUINO
+
+#include "socket.h"
+#include "ulan_time.h"
+
+namespace picolan
+{
+
+constexpr uint8_t BondTransport::MAX_MEMBERS;
+constexpr uint8_t BondTransport::PROBE_LIMIT;
+
+namespace
+{
+
+// frames are judged over windows of this length
+constexpr uint32_t ERROR_WINDOW_MS = 1000;
+
+// a link needs a few bad frames before its error rate means anything
+constexpr uint32_t MIN_ERRORS = 4;
+
+}
+
+bool BondTransport::add(Transport& link)
+{
+	if(num_members == MAX_MEMBERS) {
+		return false;
+	}
+	if(num_members == 0) {
+		window_start = now_ms();
+	}
+	members[num_members] = Member();
+	members[num_members].port.attach(link);
+	num_members++;
+	return true;
+}
+
+void BondTransport::set_probe(uint8_t source, uint8_t target, uint32_t interval_ms)
+{
+	probe_source = source;
+	probe_target = target;
+	probe_interval = interval_ms;
+	last_probe = now_ms() - interval_ms;
+	for(uint8_t i = 0; i < num_members; i++) {
+		Member& m = members[i];
+		m.probe_outstanding = false;
+		m.probes_missed = 0;
+		m.probes_answered = 0;
+		m.probe_failed = false;
+	}
+}
+
+BondMemberStats BondTransport::get_member_stats(uint8_t i) const
+{
+	BondMemberStats s = BondMemberStats();
+	if(i < num_members) {
+		const Member& m = members[i];
+		s.up = m.up();
+		s.tx_frames = m.port.get_tx_frames();
+		s.rx_frames = m.port.get_rx_frames();
+		s.rx_errors = m.port.get_rx_errors();
+		s.probes_missed = m.total_probes_missed;
+	}
+	return s;
+}
+
+void BondTransport::maintain()
+{
+	uint32_t now = now_ms();
+
+	if((probe_interval != 0) && ((now - last_probe) >= probe_interval)) {
+		last_probe = now;
+		for(uint8_t i = 0; i < num_members; i++) {
+			Member& m = members[i];
+			if(m.port.is_failed()) {
+				continue;
+			}
+			if(m.probe_outstanding) {
+				m.total_probes_missed++;
+				m.probes_answered = 0;
+				if(++m.probes_missed >= PROBE_LIMIT) {
+					m.probe_failed = true;
+				}
+			}
+			send_probe(i);
+		}
+	}
+
+	if((now - window_start) >= ERROR_WINDOW_MS) {
+		window_start = now;
+		for(uint8_t i = 0; i < num_members; i++) {
+			Member& m = members[i];
+			uint32_t frames = m.port.get_rx_frames() - m.window_frames;
+			uint32_t errors = m.port.get_rx_errors() - m.window_errors;
+			m.errors_high = (errors >= MIN_ERRORS) && ((errors*4) > (frames + errors));
+			m.window_frames = m.port.get_rx_frames();
+			m.window_errors = m.port.get_rx_errors();
+		}
+	}
+}
+
+// the payload says which link the ping went out on, though the echo may come back on any of them
+void BondTransport::send_probe(uint8_t i)
+{
+	Member& m = members[i];
+	m.probe_payload = (uint16_t)((probe_seq++ << 2) | i);
+	m.probe_outstanding = true;
+
+	uint8_t frame[9] = {PING_PACK, 5, 6, probe_source, probe_target,
+		(uint8_t)(m.probe_payload & 0xFF), (uint8_t)(m.probe_payload >> 8), 0, 0};
+	FramePort::seal(frame, sizeof(frame));
+	m.port.write(frame, sizeof(frame));
+}
+
+bool BondTransport::is_probe_echo(const uint8_t* frame, uint32_t len)
+{
+	if((frame[0] != PING_ECHO_PACK) || (len != 9) || (frame[3] != probe_target)) {
+		return false;
+	}
+	uint16_t payload = frame[5] | (frame[6] << 8);
+	for(uint8_t i = 0; i < num_members; i++) {
+		Member& p = members[i];
+		if(p.probe_outstanding && (p.probe_payload == payload)) {
+			p.probe_outstanding = false;
+			p.probes_missed = 0;
+			if(p.probe_failed && (++p.probes_answered >= 2)) {
+				p.probe_failed = false;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+int BondTransport::pick(const uint8_t* frame, uint32_t len)
+{
+	uint8_t candidates[MAX_MEMBERS];
+	uint8_t n = 0;
+	for(uint8_t i = 0; i < num_members; i++) {
+		if(members[i].up()) {
+			candidates[n++] = i;
+		}
+	}
+
+	// with every link in doubt, any link that still works is better than none
+	if(n == 0) {
+		for(uint8_t i = 0; i < num_members; i++) {
+			if(!members[i].port.is_failed()) {
+				candidates[n++] = i;
+			}
+		}
+	}
+	if(n == 0) {
+		return -1;
+	}
+
+	if(policy == ROUND_ROBIN) {
+		return candidates[rr_tx++ % n];
+	}
+
+	// pings, echoes and datagrams carry ttl, source and destination after the id and size
+	uint32_t h = frame[0];
+	if((len >= 6) && ((frame[0] == PING_PACK) || (frame[0] == PING_ECHO_PACK) || (frame[0] == DATAGRAM_PACK))) {
+		h = (uint32_t)frame[3] << 8 | frame[4];
+		if(frame[0] == DATAGRAM_PACK) {
+			h = (h << 8) | frame[5];
+		}
+	}
+	h *= 2654435761u;
+	return candidates[(h >> 16) % n];
+}
+
+int BondTransport::write(const uint8_t* buffer, uint32_t len)
+{
+	if(len == 0) {
+		return 0;
+	}
+
+	// every switch needs to see these, so they go out on every link
+	if((buffer[0] == GET_ADDR_LIST_PACK) || (buffer[0] == SUBSCRIBE_PACK)) {
+		bool sent = false;
+		for(uint8_t i = 0; i < num_members; i++) {
+			if(members[i].port.write(buffer, len) == Error::NONE) {
+				sent = true;
+			}
+		}
+		return sent ? (int)len : Error::IO;
+	}
+
+	// a failed write takes the link out of use, so the next pick is a different link
+	for(uint8_t attempt = 0; attempt < num_members; attempt++) {
+		int i = pick(buffer, len);
+		if(i < 0) {
+			break;
+		}
+		if(members[i].port.write(buffer, len) == Error::NONE) {
+			return len;
+		}
+	}
+	return Error::IO;
+}
+
+int BondTransport::read(uint8_t* buffer, uint32_t len)
+{
+	// links take turns so a busy one can't starve the others
+	for(uint8_t n = 0; n < num_members; n++) {
+		uint8_t i = (rr_rx + n) % num_members;
+		int r;
+		while((r = members[i].port.read(buffer, len)) > 0) {
+			// echoes of the bond's own pings aren't passed on
+			if(!is_probe_echo(buffer, r)) {
+				rr_rx = i+1;
+				return r;
+			}
+		}
+	}
+	return 0;
+}
+
+uint32_t BondTransport::available()
+{
+	maintain();
+	uint32_t n = 0;
+	for(uint8_t i = 0; i < num_members; i++) {
+		n += members[i].port.available();
+	}
+	return n;
+}
+
+void BondTransport::flush()
+{
+	for(uint8_t i = 0; i < num_members; i++) {
+		members[i].port.flush();
+	}
+}
+
+}
+
+#endif
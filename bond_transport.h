@@ -0,0 +1,173 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_BOND_TRANSPORT_H
+#define PICOLAN_BOND_TRANSPORT_H
+
+#ifndef ARDUINO
+
+#include "frame_port.h"
+
+namespace picolan
+{
+
+	/**
+	 * BondMemberStats describes one link of a BondTransport.
+	 */
+	struct BondMemberStats
+	{
+		bool up;
+		uint32_t tx_frames;
+		uint32_t rx_frames;
+		uint32_t rx_errors;
+		uint32_t probes_missed;
+	};
+
+
+	/**
+	 * BondTransport joins several links into one, such as spare UARTs to the same switch or
+	 * links to two switches. Frames are spread over the links that are up, so an interface
+	 * gets the capacity of all of them and keeps running when one fails.
+	 *
+	 * With the FLOW_HASH policy, every frame of a flow uses the same link, so frames are never
+	 * reordered. A flow is the source, destination and port of a datagram, and a stream
+	 * connection is a datagram flow, so its segments stay in order. ROUND_ROBIN spreads
+	 * every frame across the links. Frames can then arrive out of order, which datagram
+	 * applications may accept but which makes streams retransmit. Requests for the address
+	 * list and subscriptions go out on every link, so every switch learns about this node.
+	 *
+	 * A link is taken out of use when it reports an I/O error, when more than a quarter of the
+	 * frames it receives in a second fail their checksum, or when it misses PROBE_LIMIT pings in
+	 * a row. It comes back when its errors stop and its pings are answered again.
+	 * Pings are only sent if set_probe() has been called.
+	 *
+	 * \code
+	 * LinuxSerial a, b;
+	 * a.open("/dev/ttyUSB0", 1000000);
+	 * b.open("/dev/ttyUSB1", 1000000);
+	 * BondTransport bond;
+	 * bond.add(a);
+	 * bond.add(b);
+	 * Interface iface(bond);
+	 * \endcode
+	 */
+	class BondTransport : public Transport
+	{
+		public:
+			static constexpr uint8_t MAX_MEMBERS = 4;
+			static constexpr uint8_t PROBE_LIMIT = 3;
+
+			enum POLICY : uint8_t
+			{
+				FLOW_HASH,
+				ROUND_ROBIN
+			};
+
+			/**
+			 * \brief adds a link. Links that carry whole frames and byte streams can be mixed.
+			 * \return false if the bond already has MAX_MEMBERS links
+			 */
+			bool add(Transport& link);
+
+			void set_policy(uint8_t p) {
+				policy = p;
+			}
+
+			/**
+			 * \brief pings a node over every link to check that frames get through.
+			 * @param source the address of the interface using the bond
+			 * @param target a node that answers pings, such as the switch's own address
+			 * @param interval_ms the time between pings on each link, or zero to stop
+			 */
+			void set_probe(uint8_t source, uint8_t target, uint32_t interval_ms);
+
+			uint8_t count() const {
+				return num_members;
+			}
+
+			bool is_up(uint8_t i) const {
+				return (i < num_members) && members[i].up();
+			}
+
+			BondMemberStats get_member_stats(uint8_t i) const;
+
+			int read(uint8_t* buffer, uint32_t len);
+			int write(const uint8_t* buffer, uint32_t len);
+			uint32_t available();
+			void flush();
+
+			bool is_framed() const {
+				return true;
+			}
+
+		private:
+			struct Member
+			{
+				FramePort port;
+
+				bool probe_failed = false;
+				bool errors_high = false;
+
+				uint16_t probe_payload = 0;
+				bool probe_outstanding = false;
+				uint8_t probes_missed = 0;
+				uint8_t probes_answered = 0;
+				uint32_t total_probes_missed = 0;
+
+				// the port's counters when the error window started
+				uint32_t window_frames = 0;
+				uint32_t window_errors = 0;
+
+				bool up() const {
+					return !port.is_failed() && !probe_failed && !errors_high;
+				}
+			};
+
+			void maintain();
+			void send_probe(uint8_t i);
+			bool is_probe_echo(const uint8_t* frame, uint32_t len);
+			int pick(const uint8_t* frame, uint32_t len);
+
+			Member members[MAX_MEMBERS];
+			uint8_t num_members = 0;
+			uint8_t policy = FLOW_HASH;
+			uint8_t rr_tx = 0;
+			uint8_t rr_rx = 0;
+
+			uint8_t probe_source = 0;
+			uint8_t probe_target = 0;
+			uint32_t probe_interval = 0;
+			uint32_t last_probe = 0;
+			uint16_t probe_seq = 0;
+			uint32_t window_start = 0;
+	};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef PICOLAN_CAPTURE_H
+#define PICOLAN_CAPTURE_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#include <atomic>
+#endif
+
+#include "config.h"
+#include "ulan_time.h"
+#include "counters.h"
+
+namespace picolan
+{
+
+	/**
+	 * The maximum length of a captured frame. This is MAX_FRAME_LENGTH, repeated here so
+	 * the capture ring doesn't depend on the serialiser.
+	 */
+	constexpr uint16_t CAPTURE_FRAME_LENGTH = Config::MAX_PACKET_LENGTH+2;
+
+	enum CAPTURE_DIRECTION : uint8_t
+	{
+		CAPTURE_RX,
+		CAPTURE_TX
+	};
+
+	/**
+	 * One frame in a CaptureRing. The frame is as it appears on the wire without the
+	 * start and end bytes or byte stuffing: id, size, body and checksum.
+	 */
+	struct CaptureRecord
+	{
+		uint64_t time_us;
+		uint8_t direction;
+		uint8_t len;
+		uint8_t frame[CAPTURE_FRAME_LENGTH];
+	};
+
+	/**
+	 * CaptureRing is a lock free single producer, single consumer queue of captured frames.
+	 * The interface is the producer and never waits: when the ring is full the frame is dropped
+	 * and counted. The consumer, such as a PcapWriter, may run on another thread.
+	 * The storage is provided by the caller and the number of records must be a power of two.
+	 */
+	class CaptureRing
+	{
+		public:
+			/**
+			 * @param records storage for the ring
+			 * @param n the number of records, a power of two
+			 */
+			CaptureRing(CaptureRecord* records, uint32_t n) : records(records), mask(n-1) { }
+
+			CaptureRing(const CaptureRing&) = delete;
+			CaptureRing& operator=(const CaptureRing&) = delete;
+
+			/**
+			 * \brief adds a frame to the ring. Called by the interface.
+			 * \return false if the ring was full and the frame was dropped
+			 */
+			bool push(uint8_t direction, const uint8_t* frame, uint8_t len) {
+				uint32_t h = load(head);
+				if((h - acquire(tail)) > mask) {
+					dropped.add();
+					return false;
+				}
+				CaptureRecord& r = records[h & mask];
+				r.time_us = now_us();
+				r.direction = direction;
+				r.len = (len > CAPTURE_FRAME_LENGTH) ? CAPTURE_FRAME_LENGTH : len;
+				for(uint8_t i = 0; i < r.len; i++) {
+					r.frame[i] = frame[i];
+				}
+				release(head, h+1);
+				return true;
+			}
+
+			/**
+			 * \brief returns the oldest record without removing it, or nullptr if the ring is empty.
+			 * Called by the consumer.
+			 */
+			const CaptureRecord* peek() {
+				uint32_t t = load(tail);
+				if(t == acquire(head)) {
+					return nullptr;
+				}
+				return &records[t & mask];
+			}
+
+			/**
+			 * \brief removes the record returned by peek(). Called by the consumer.
+			 */
+			void pop() {
+				release(tail, load(tail)+1);
+			}
+
+			/**
+			 * \brief returns the number of frames dropped because the ring was full.
+			 */
+			uint32_t get_dropped() const {
+				return dropped.get();
+			}
+
+		private:
+			#ifdef ARDUINO
+			typedef volatile uint32_t Index;
+			static uint32_t load(const Index& i) { return i; }
+			static uint32_t acquire(const Index& i) { return i; }
+			static void release(Index& i, uint32_t v) { i = v; }
+			#else
+			typedef std::atomic<uint32_t> Index;
+			static uint32_t load(const Index& i) { return i.load(std::memory_order_relaxed); }
+			static uint32_t acquire(const Index& i) { return i.load(std::memory_order_acquire); }
+			static void release(Index& i, uint32_t v) { i.store(v, std::memory_order_release); }
+			#endif
+
+			CaptureRecord* records;
+			uint32_t mask;
+			Index head{0};
+			Index tail{0};
+			Counter dropped;
+	};
+
+}
+
+#endif
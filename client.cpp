@@ -38,20 +38,32 @@ namespace picolan
 		remote_port = port;
 		remote = r;
 
-		auto err = send_syn();
+		if(fast_open) {
+			state = CONNECTION_FAST_OPEN;
+			return Error::NONE;
+		}
+
+		return handshake(nullptr, 0);
+	}
+
+	int Client::handshake(const uint8_t* data, uint32_t len)
+	{
+		uint64_t latency_start = latency_clock();
+		auto err = send_syn(data, len);
 		if(err != Error::NONE) {
 			return err;
 		}
 
 		state = CONNECTION_SYN_SENT;
 
-		auto start = millis();
+		auto start = now_ms();
 		uint32_t dt = 0;
 		do
 		{
 			iface->read();
-			dt = millis() - start;
+			dt = now_ms() - start;
 			if(dt > timeout) {
+				counters.timeouts.add();
 				state = CONNECTION_CLOSED;
 				return -1;
 			}
@@ -65,6 +77,8 @@ namespace picolan
 
 		SocketStream::send_ack();
 		state = CONNECTION_OPEN;
+		on_open();
+		record_latency(LATENCY_CONNECT, latency_start);
 		return Error::NONE;
 	}
 
@@ -80,9 +94,16 @@ namespace picolan
 				return;
 			case CONNECTION_SYN_SENT:
 				{
-					if(data[0] == MESSAGE_TYPE::SYN) {
+					if((data[0] == MESSAGE_TYPE::SYN) && (len >= 3)) {
 						remote_sequence = data[1];
+						// the server may move the connection to another port
+						remote_port = data[2];
 						state = CONNECTION_SYN_RECVED;
+
+						// the server may have replied in its SYN
+						for(uint32_t i = 3; i < len; i++) {
+							rx_put(data[i]);
+						}
 					} else if(data[0] == MESSAGE_TYPE::CLOSE) {
 						state = CONNECTION_CLOSED;
 					}
@@ -96,27 +117,11 @@ namespace picolan
 				}
 				break;
 			case CONNECTION_OPEN:
-				{
-					if(data[0] == MESSAGE_TYPE::CLOSE) {
-						state = CONNECTION_CLOSED;
-					}
-					if(data[0] == MESSAGE_TYPE::ACK) {
-						last_recved_ack = data[1];
-					}
-
-					if(data[0] == MESSAGE_TYPE::DATA) {
-						if(data[1] == (remote_sequence+1)) {
-							remote_sequence++;
-							for(uint32_t i = 2; i < len; i++) {
-								ringbuf.put(data[i]);
-							}
-						}
-						send_ack();
-					}
-				}
+				on_stream_data(data, len);
 				break;
 			case CONNECTION_LISTENING:
 			case CONNECTION_PENDING:
+			case CONNECTION_FAST_OPEN:
 			break;
 		}
 	}
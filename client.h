@@ -68,14 +68,31 @@ namespace picolan
 
 			/**
 			 * \brief connect() will attempt to establish a connection with a server.
+			 * In fast open mode connect() returns immediately and the handshake
+			 * is made by the first call to write().
 			 * @param r Server address
 			 * @param port Server port number
 			 *
 			 */
 			int connect(uint8_t remote, uint8_t port);
 
+			/**
+			 * \brief enables or disables fast open.
+			 * With fast open the first bytes passed to SocketStream::write() are carried in the SYN,
+			 * so a short request reaches the server without waiting for the handshake.
+			 * This works through a SocketStream reference too, such as a Multiplexer's stream.
+			 * The server can put its reply in its own SYN (see Server::accept()).
+			 * Only use fast open with servers that support it; older servers drop the SYN payload.
+			 */
+			void set_fast_open(bool en = true) {
+				fast_open = en;
+			}
+
 		private:
+			int handshake(const uint8_t* data, uint32_t len);
 			void on_data(uint8_t remote, const uint8_t* data, uint32_t len);
+
+			bool fast_open = false;
 	};
 }
 
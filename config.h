@@ -0,0 +1,162 @@
+#ifndef PICOLAN_CONFIG_H
+#define PICOLAN_CONFIG_H
+
+#include <stdint.h>
+
+/**
+ * Profiles set the sizes and limits of the library together, so memory can be traded for
+ * throughput on each target without changing the library. PICOLAN_PROFILE chooses one of the
+ * profiles below. If it isn't defined, the profile is picked from the target.
+ *
+ * For a profile of your own, derive a struct from one of these and override what you need.
+ * Then define PICOLAN_CONFIG to its name and PICOLAN_CONFIG_HEADER to the header that declares it.
+ */
+#define PICOLAN_PROFILE_AVR 1
+#define PICOLAN_PROFILE_CORTEX_M 2
+#define PICOLAN_PROFILE_HOST 3
+
+#ifndef PICOLAN_PROFILE
+	#if defined(__AVR__)
+		#define PICOLAN_PROFILE PICOLAN_PROFILE_AVR
+	#elif defined(ARDUINO)
+		#define PICOLAN_PROFILE PICOLAN_PROFILE_CORTEX_M
+	#else
+		#define PICOLAN_PROFILE PICOLAN_PROFILE_HOST
+	#endif
+#endif
+
+namespace picolan
+{
+
+/**
+ * CortexMProfile suits 32 bit microcontrollers with tens of kilobytes of RAM.
+ * The other profiles start from it.
+ */
+struct CortexMProfile
+{
+	/**
+	 * The longest packet, including its header and checksum. This is part of the wire format,
+	 * so every node on a network must use the same value. All the shipped profiles use 64.
+	 */
+	static constexpr uint16_t MAX_PACKET_LENGTH = 64;
+
+	/** the number of sockets that can be bound to an interface */
+	static constexpr uint16_t MAX_SOCKETS = 16;
+
+	/** the number of stream connections an interface can hold open. It must be a power of two. */
+	static constexpr uint32_t CONNECTION_TABLE_SIZE = 32;
+
+	/**
+	 * The number of frames a stream sends before it waits for an acknowledgement.
+	 * Peers should agree on it, because a receiver only holds this many frames for FEC recovery.
+	 */
+	static constexpr uint32_t FRAME_BURST = 4;
+
+	/** the receive buffer of each socket the node binding creates */
+	static constexpr uint32_t SOCKET_BUFFER = 128;
+
+	/** the longest C string that Datagram::write() will send */
+	static constexpr uint32_t MAX_STRING_LENGTH = 1024;
+
+	/**
+	 * Each of the four levels of the timer wheel has 2^TIMER_WHEEL_BITS slot pointers.
+	 * 6 covers deadlines up to about 4.6 hours away with 256 pointers, 4 covers about
+	 * 65 seconds with 64. Longer deadlines still work, they are carried over on the top level.
+	 */
+	static constexpr uint32_t TIMER_WHEEL_BITS = 6;
+
+	/** the most connection requests a Server can queue, see Server::listen() */
+	static constexpr uint8_t MAX_BACKLOG = 4;
+
+	/** the number of destinations that can be paced individually, see Interface::set_dest_pacing() */
+	static constexpr uint8_t PACED_DESTINATIONS = 8;
+
+	/** the number of probes a PingEngine can have in flight */
+	static constexpr uint8_t PING_OUTSTANDING = 32;
+
+	/**
+	 * The blocks an interface reads from and writes to its transport in. Only hosts use them.
+	 * The read block must hold a whole frame for framed transports.
+	 */
+	static constexpr uint32_t RX_BLOCK = 256;
+	static constexpr uint32_t TX_BLOCK = 512;
+
+	/**
+	 * The most RAM an Interface may take, not counting the PICOLAN_LATENCY_STATS histograms.
+	 * It is checked when picolan.h is compiled. A 64 bit host build is the largest because of
+	 * its pointers, so the budgets allow for that and the targets themselves come in under them.
+	 */
+	static constexpr uint32_t INTERFACE_RAM = 4096;
+};
+
+/**
+ * AvrProfile suits 8 bit parts with a few kilobytes of RAM.
+ */
+struct AvrProfile : CortexMProfile
+{
+	static constexpr uint16_t MAX_SOCKETS = 4;
+	static constexpr uint32_t CONNECTION_TABLE_SIZE = 4;
+	static constexpr uint32_t SOCKET_BUFFER = 64;
+	static constexpr uint32_t MAX_STRING_LENGTH = 256;
+	static constexpr uint32_t TIMER_WHEEL_BITS = 4;
+	static constexpr uint8_t MAX_BACKLOG = 1;
+	static constexpr uint8_t PACED_DESTINATIONS = 2;
+	static constexpr uint8_t PING_OUTSTANDING = 4;
+	static constexpr uint32_t RX_BLOCK = 80;
+	static constexpr uint32_t TX_BLOCK = 64;
+	static constexpr uint32_t INTERFACE_RAM = 1280;
+};
+
+/**
+ * HostProfile suits Linux and other hosts such as gateways, which bind many more sockets.
+ */
+struct HostProfile : CortexMProfile
+{
+	static constexpr uint16_t MAX_SOCKETS = 32;
+	static constexpr uint32_t CONNECTION_TABLE_SIZE = 64;
+	static constexpr uint32_t INTERFACE_RAM = 4608;
+};
+
+}
+
+// a custom profile can derive from the ones above
+#ifdef PICOLAN_CONFIG_HEADER
+#include PICOLAN_CONFIG_HEADER
+#endif
+
+namespace picolan
+{
+
+#if defined(PICOLAN_CONFIG)
+using Config = PICOLAN_CONFIG;
+#elif PICOLAN_PROFILE == PICOLAN_PROFILE_AVR
+using Config = AvrProfile;
+#elif PICOLAN_PROFILE == PICOLAN_PROFILE_CORTEX_M
+using Config = CortexMProfile;
+#else
+using Config = HostProfile;
+#endif
+
+// a frame is passed around with a uint8 length, and must carry a whole address list
+static_assert((Config::MAX_PACKET_LENGTH >= 40) && (Config::MAX_PACKET_LENGTH <= 253),
+		"MAX_PACKET_LENGTH must be between 40 and 253");
+static_assert(Config::MAX_SOCKETS >= 1, "an interface needs at least one socket");
+static_assert((Config::CONNECTION_TABLE_SIZE >= 1) && (Config::CONNECTION_TABLE_SIZE <= 256)
+		&& ((Config::CONNECTION_TABLE_SIZE & (Config::CONNECTION_TABLE_SIZE-1)) == 0),
+		"CONNECTION_TABLE_SIZE must be a power of two no larger than 256");
+static_assert((Config::FRAME_BURST >= 1) && (Config::FRAME_BURST <= 8),
+		"FRAME_BURST must be between 1 and the largest FEC group of 8");
+static_assert(Config::SOCKET_BUFFER >= Config::MAX_PACKET_LENGTH,
+		"SOCKET_BUFFER must hold at least one packet");
+static_assert(Config::MAX_STRING_LENGTH >= 1, "MAX_STRING_LENGTH can't be zero");
+static_assert((Config::TIMER_WHEEL_BITS >= 2) && (Config::TIMER_WHEEL_BITS <= 8),
+		"TIMER_WHEEL_BITS must be between 2 and 8");
+static_assert(Config::MAX_BACKLOG >= 1, "MAX_BACKLOG can't be zero");
+static_assert(Config::PACED_DESTINATIONS >= 1, "PACED_DESTINATIONS can't be zero");
+static_assert(Config::PING_OUTSTANDING >= 1, "PING_OUTSTANDING can't be zero");
+static_assert(Config::RX_BLOCK >= Config::MAX_PACKET_LENGTH+2u, "RX_BLOCK must hold a whole frame");
+static_assert(Config::TX_BLOCK >= 1, "TX_BLOCK can't be zero");
+
+}
+
+#endif
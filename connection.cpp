@@ -0,0 +1,71 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#include "connection.h"
+#include "picolan.h"
+
+namespace picolan
+{
+
+void Connection::on_data(uint8_t r, const uint8_t* data, uint32_t len)
+{
+	if(remote != r) {
+		return;
+	}
+
+	switch(state)
+	{
+		case CONNECTION_PENDING:
+			{
+				if(data[0] == MESSAGE_TYPE::ACK) {
+					state = CONNECTION_OPEN;
+					on_open();
+				}
+				if(data[0] == MESSAGE_TYPE::CLOSE) {
+					state = CONNECTION_CLOSED;
+				}
+			}
+			break;
+		case CONNECTION_OPEN:
+			on_stream_data(data, len);
+			break;
+		default:
+			break;
+	}
+
+	if(state == CONNECTION_CLOSED) {
+		on_close();
+	}
+}
+
+void Connection::on_close()
+{
+	if(iface != nullptr) {
+		iface->unregister_connection(*this);
+	}
+}
+
+}
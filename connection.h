@@ -0,0 +1,80 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#ifndef PICOLAN_CONNECTION_H
+#define PICOLAN_CONNECTION_H
+
+#include "socket_stream.h"
+
+namespace picolan
+{
+
+	/**
+	 * A Connection is one client session accepted by a listening Server.
+	 * A server that was started with a backlog (see Server::listen()) hands each
+	 * client to its own Connection with Server::accept(Connection&), so any number of
+	 * clients can be served on a single port. Connections are registered with the
+	 * interface by remote address and port so incoming frames reach them directly.
+	 * When one node has several clients connected to the same server, each connection
+	 * after the first is given a free local port (see get_port()) that the client sends to.
+	 * Once accepted, use SocketStream::read() and SocketStream::write() as normal.
+	 */
+
+	class Connection : public SocketStream
+	{
+		public:
+			/**
+			 * \brief connection constructor
+			 * @param bf a pointer to a buffer where bytes can be stored temporarily until they are read()
+			 * @param len the length of the buffer. generally 64 bytes is adequate.
+			 */
+			#ifndef PICOLAN_NODE_BINDING
+			Connection(uint8_t* bf, uint32_t len)
+				: SocketStream(bf, len, 0)
+			#else
+			Connection() : SocketStream(0)
+			#endif
+			{
+				state = CONNECTION_CLOSED;
+			}
+
+			/**
+			 * \brief returns the port number of the client
+			 * \return the port number of the client/remote socket
+			 */
+			uint8_t get_remote_port() {
+				return remote_port;
+			}
+
+		private:
+			friend class Server;
+
+			void on_data(uint8_t remote, const uint8_t* data, uint32_t len);
+			void on_close();
+	};
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef PICOLAN_CONNECTION_TABLE_H
+#define PICOLAN_CONNECTION_TABLE_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "config.h"
+
+namespace picolan
+{
+
+class Socket;
+
+/**
+ * ConnectionTable maps a (remote address, port) pair to the socket that owns the connection.
+ * It is a fixed size open addressing hash table so lookups, inserts and removals take
+ * constant time and no memory is allocated.
+ *
+ * Stream frames only carry the local port, so each connection from a remote node is given
+ * a local port of its own (see Interface::connection_port()). The remote port taken from
+ * the SYN is stored alongside so a connection can also be found by (remote address, remote port).
+ */
+class ConnectionTable
+{
+public:
+	// must be a power of two, see Config
+	static constexpr uint32_t SIZE = Config::CONNECTION_TABLE_SIZE;
+
+	ConnectionTable() {
+		for(uint32_t i = 0; i < SIZE; i++) {
+			slots[i] = nullptr;
+		}
+	}
+
+	/**
+	 * \brief adds a socket to the table.
+	 * \return false if the table is full or the key is already in use.
+	 */
+	bool insert(uint8_t remote, uint8_t port, uint8_t remote_port, Socket* s) {
+		uint16_t k = key(remote, port);
+		uint32_t i = hash(k);
+		for(uint32_t n = 0; n < SIZE; n++) {
+			if(slots[i] == nullptr) {
+				slots[i] = s;
+				keys[i] = k;
+				remote_ports[i] = remote_port;
+				return true;
+			}
+			if(keys[i] == k) {
+				return false;
+			}
+			i = (i+1) & (SIZE-1);
+		}
+		return false;
+	}
+
+	/**
+	 * \brief finds the socket for a connection.
+	 * \return the socket, or nullptr if there is no such connection.
+	 */
+	Socket* find(uint8_t remote, uint8_t port) const {
+		uint16_t k = key(remote, port);
+		uint32_t i = hash(k);
+		for(uint32_t n = 0; n < SIZE; n++) {
+			if(slots[i] == nullptr) {
+				return nullptr;
+			}
+			if(keys[i] == k) {
+				return slots[i];
+			}
+			i = (i+1) & (SIZE-1);
+		}
+		return nullptr;
+	}
+
+	/**
+	 * \brief finds a connection by the remote address and the remote port.
+	 * This searches every slot, it is only used when a SYN arrives.
+	 * \return the socket, or nullptr if there is no such connection.
+	 */
+	Socket* find_remote(uint8_t remote, uint8_t remote_port) const {
+		for(uint32_t i = 0; i < SIZE; i++) {
+			if((slots[i] != nullptr) && ((keys[i] >> 8) == remote) && (remote_ports[i] == remote_port)) {
+				return slots[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * \brief removes a socket from the table.
+	 */
+	void remove(Socket* s) {
+		for(uint32_t i = 0; i < SIZE; i++) {
+			if(slots[i] == s) {
+				erase(i);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief returns the socket in slot i, or nullptr if the slot is empty.
+	 * Used to iterate over every connection.
+	 */
+	Socket* slot(uint32_t i) const {
+		return slots[i];
+	}
+
+private:
+	static uint16_t key(uint8_t remote, uint8_t port) {
+		return (remote << 8) | port;
+	}
+
+	static uint32_t hash(uint16_t k) {
+		return ((k * 40503u) >> 8) & (SIZE-1);
+	}
+
+	// backward shift deletion keeps probe sequences intact without tombstones
+	void erase(uint32_t i) {
+		slots[i] = nullptr;
+		uint32_t j = i;
+		while(true) {
+			j = (j+1) & (SIZE-1);
+			if(slots[j] == nullptr) {
+				return;
+			}
+			uint32_t home = hash(keys[j]);
+			bool movable = (i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j));
+			if(movable) {
+				slots[i] = slots[j];
+				keys[i] = keys[j];
+				remote_ports[i] = remote_ports[j];
+				slots[j] = nullptr;
+				i = j;
+			}
+		}
+	}
+
+	Socket* slots[SIZE];
+	uint16_t keys[SIZE];
+	uint8_t remote_ports[SIZE];
+};
+
+}
+
+#endif
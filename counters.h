@@ -0,0 +1,156 @@
+#ifndef PICOLAN_COUNTERS_H
+#define PICOLAN_COUNTERS_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#include <atomic>
+#endif
+
+namespace picolan
+{
+
+/**
+ * Counter is an event counter that is cheap enough to bump for every byte.
+ * Each counter has a single writer, the thread servicing the interface, so on a host it is
+ * a relaxed atomic that is loaded and stored rather than incremented with a locked
+ * instruction. Other threads may read it at any time. On a microcontroller it is a plain integer.
+ * Counters wrap at 2^32, so compare readings by subtraction.
+ */
+class Counter
+{
+public:
+	Counter() { }
+	Counter(const Counter&) = delete;
+	Counter& operator=(const Counter&) = delete;
+
+	void add(uint32_t n = 1) {
+		#ifdef ARDUINO
+		v += n;
+		#else
+		v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		#endif
+	}
+
+	uint32_t get() const {
+		#ifdef ARDUINO
+		return v;
+		#else
+		return v.load(std::memory_order_relaxed);
+		#endif
+	}
+
+	void reset() {
+		#ifdef ARDUINO
+		v = 0;
+		#else
+		v.store(0, std::memory_order_relaxed);
+		#endif
+	}
+
+private:
+	#ifdef ARDUINO
+	uint32_t v = 0;
+	#else
+	std::atomic<uint32_t> v{0};
+	#endif
+};
+
+
+/**
+ * LinkStats is a snapshot of the counters kept by the frame parser and serialiser.
+ */
+struct LinkStats
+{
+	/** frames received with a good checksum */
+	uint32_t rx_frames = 0;
+	/** bytes read from the link, including framing and escape bytes */
+	uint32_t rx_bytes = 0;
+	/** frames dropped because the checksum didn't match, usually line noise */
+	uint32_t checksum_errors = 0;
+	/** times the parser abandoned a partial frame, for example when a start byte arrived mid frame */
+	uint32_t resyncs = 0;
+	/** frames written to the link */
+	uint32_t tx_frames = 0;
+	/** bytes written to the link, including framing and escape bytes */
+	uint32_t tx_bytes = 0;
+	/** escape bytes added to outgoing frames */
+	uint32_t tx_escapes = 0;
+};
+
+class LinkCounters
+{
+public:
+	Counter rx_frames;
+	Counter rx_bytes;
+	Counter checksum_errors;
+	Counter resyncs;
+	Counter tx_frames;
+	Counter tx_bytes;
+	Counter tx_escapes;
+
+	LinkStats snapshot() const {
+		LinkStats s;
+		s.rx_frames = rx_frames.get();
+		s.rx_bytes = rx_bytes.get();
+		s.checksum_errors = checksum_errors.get();
+		s.resyncs = resyncs.get();
+		s.tx_frames = tx_frames.get();
+		s.tx_bytes = tx_bytes.get();
+		s.tx_escapes = tx_escapes.get();
+		return s;
+	}
+
+	void reset() {
+		rx_frames.reset();
+		rx_bytes.reset();
+		checksum_errors.reset();
+		resyncs.reset();
+		tx_frames.reset();
+		tx_bytes.reset();
+		tx_escapes.reset();
+	}
+};
+
+
+/**
+ * SocketStats is a snapshot of the counters kept by a socket.
+ */
+struct SocketStats
+{
+	uint8_t port = 0;
+	uint8_t remote = 0;
+	/** datagram frames addressed to the socket, including stream control frames */
+	uint32_t rx_frames = 0;
+	/** bytes delivered into the receive buffer */
+	uint32_t rx_bytes = 0;
+	/** bytes dropped because the receive buffer was full, a sign of a slow consumer */
+	uint32_t rx_overflows = 0;
+	/** times unacknowledged stream frames were sent again */
+	uint32_t retransmits = 0;
+	/** writes and connections that gave up waiting for the remote */
+	uint32_t timeouts = 0;
+};
+
+class SocketCounters
+{
+public:
+	Counter rx_frames;
+	Counter rx_bytes;
+	Counter rx_overflows;
+	Counter retransmits;
+	Counter timeouts;
+
+	void reset() {
+		rx_frames.reset();
+		rx_bytes.reset();
+		rx_overflows.reset();
+		retransmits.reset();
+		timeouts.reset();
+	}
+};
+
+}
+
+#endif
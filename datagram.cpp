@@ -25,6 +25,7 @@
 
 #include "datagram.h"
 #include "picolan.h"
+#include "fec.h"
 
 namespace picolan
 {
@@ -38,7 +39,15 @@ int Datagram::write(uint8_t dest, uint8_t dest_port,  std::vector<uint8_t> data)
 
 #endif
 
-	const uint32_t CHUNK_SZ = 58;
+	if(fec != nullptr) {
+		#ifndef PICOLAN_NODE_BINDING
+		return write_fec(dest, dest_port, data, len);
+		#else
+		return write_fec(dest, dest_port, data.data(), len);
+		#endif
+	}
+
+	const uint32_t CHUNK_SZ = MAX_DATAGRAM_PAYLOAD;
 	uint32_t chunks = len/CHUNK_SZ;
 
 	for(uint32_t i = 0; i < chunks; i++)
@@ -48,6 +57,7 @@ int Datagram::write(uint8_t dest, uint8_t dest_port,  std::vector<uint8_t> data)
 		pack.dest_addr = dest;
 		pack.source_addr = iface->get_address();
 		pack.port = dest_port;
+		pack.priority = priority;
 
 		for(uint32_t j = 0; j < CHUNK_SZ; j++)
 		{
@@ -63,6 +73,7 @@ int Datagram::write(uint8_t dest, uint8_t dest_port,  std::vector<uint8_t> data)
 		pack.dest_addr = dest;
 		pack.source_addr = iface->get_address();
 		pack.port = dest_port;
+		pack.priority = priority;
 		for(uint32_t i = 0; i < remainder; i++)
 		{
 			pack.payload.append(data[chunks*CHUNK_SZ + i]);
@@ -77,7 +88,7 @@ int Datagram::write(uint8_t dest, uint8_t dest_port,  std::vector<uint8_t> data)
 #ifndef PICOLAN_NODE_BINDING
 int Datagram::write(uint8_t dest, uint8_t dest_port, const char* data)
 {
-    uint32_t len = etk::Rope::c_strlen(data, 1024);
+    uint32_t len = etk::Rope::c_strlen(data, Config::MAX_STRING_LENGTH);
     return write(dest, dest_port, (uint8_t*)data, len);
 }
 #endif
@@ -92,13 +103,137 @@ void Datagram::subscribe(bool sub) {
     iface->flush();
 }
 
+int Datagram::write_fec(uint8_t dest, uint8_t dest_port, const uint8_t* data, uint32_t len)
+{
+	// each frame carries a group number and its index in the group
+	const uint32_t CHUNK_SZ = Fec::MAX_FRAME-1;
+
+	uint32_t pos = 0;
+	fec->reset_encoder(0);
+	while(pos < len)
+	{
+		uint8_t index = fec->count();
+		if(index == 0) {
+			fec_tx_group++;
+		}
+
+		uint32_t n = len-pos;
+		if(n > CHUNK_SZ) {
+			n = CHUNK_SZ;
+		}
+
+		auto pack = iface->create_packet<datagram_pack>();
+		pack.ttl = 6;
+		pack.dest_addr = dest;
+		pack.source_addr = iface->get_address();
+		pack.port = dest_port;
+		pack.priority = priority;
+		pack.payload.append(fec_tx_group);
+		pack.payload.append(index);
+		for(uint32_t i = 0; i < n; i++) {
+			pack.payload.append(data[pos+i]);
+		}
+		pack.send();
+
+		fec->add(&data[pos], n);
+		pos += n;
+
+		// parity frames are marked by the top bit of the index, which holds the group size
+		if((fec->count() == fec_k) || (pos == len)) {
+			auto parity = iface->create_packet<datagram_pack>();
+			parity.ttl = 6;
+			parity.dest_addr = dest;
+			parity.source_addr = iface->get_address();
+			parity.port = dest_port;
+			parity.priority = priority;
+			parity.payload.append(fec_tx_group);
+			parity.payload.append(0x80 | fec->count());
+			parity.payload.append(fec->len_xor());
+			for(uint32_t i = 0; i < fec->parity_len(); i++) {
+				parity.payload.append(fec->parity()[i]);
+			}
+			parity.send();
+			fec->reset_encoder(0);
+		}
+	}
+
+	iface->flush();
+	return Error::NONE;
+}
+
+// Frames are delivered in order. One that arrives after a gap is held until the gap is filled
+// by the parity frame or the group ends, so a rebuilt frame can't land after the ones that follow it.
+void Datagram::on_fec_data(uint8_t r, const uint8_t* data, uint32_t len)
+{
+	if(len < 2) {
+		return;
+	}
+
+	uint8_t group = data[0];
+	uint8_t index = data[1];
+	if(!fec_rx_valid || (r != fec_rx_remote) || (group != fec_rx_group)) {
+		fec_end_group();
+		fec_rx_group = group;
+		fec_rx_remote = r;
+		fec_rx_valid = true;
+	}
+
+	// parity frames are marked by the top bit of the index, which holds the group size
+	if(index & 0x80) {
+		uint8_t id;
+		if(len >= 3) {
+			fec->recover(0, index & 0x7F, data[2], &data[3], len-3, id);
+		}
+		fec_end_group();
+		// late frames of a finished group are dropped rather than delivered out of order
+		fec_rx_next = Fec::MAX_GROUP;
+		return;
+	}
+
+	if((index < fec_rx_next) || (index >= Fec::MAX_GROUP)) {
+		return;
+	}
+	fec->store(index, &data[2], len-2);
+
+	// held frames are kept until the group ends, since the parity needs all of them
+	while((fec_rx_next < Fec::MAX_GROUP) && fec->has(fec_rx_next)) {
+		uint32_t n;
+		const uint8_t* d = fec->data(fec_rx_next, n);
+		for(uint32_t i = 0; i < n; i++) {
+			rx_put(d[i]);
+		}
+		fec_rx_next++;
+	}
+}
+
+// delivers whatever is held of the group in order, skipping frames that were lost
+void Datagram::fec_end_group()
+{
+	for(uint8_t id = fec_rx_next; id < Fec::MAX_GROUP; id++) {
+		if(fec->has(id)) {
+			uint32_t n;
+			const uint8_t* d = fec->data(id, n);
+			for(uint32_t i = 0; i < n; i++) {
+				rx_put(d[i]);
+			}
+		}
+	}
+	fec->reset_decoder();
+	fec_rx_next = 0;
+}
+
 void Datagram::on_data(uint8_t r, const uint8_t* data, uint32_t len)
 {
 	remote = r;
+	if(fec != nullptr) {
+		on_fec_data(r, data, len);
+		return;
+	}
+
 	uint32_t i = 0;
 	while(i != len)
 	{
-		ringbuf.put(data[i++]);
+		rx_put(data[i++]);
 	}
 }
 
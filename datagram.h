@@ -82,8 +82,19 @@ namespace picolan
             }
 
 		private:
+			int write_fec(uint8_t dest, uint8_t port, const uint8_t* data, uint32_t len);
 			void on_data(
 					uint8_t remote, const uint8_t* data, uint32_t len);
+			void on_fec_data(
+					uint8_t remote, const uint8_t* data, uint32_t len);
+			void fec_end_group();
+
+			uint8_t fec_tx_group = 0;
+			uint8_t fec_rx_group = 0;
+			uint8_t fec_rx_remote = 0;
+			bool fec_rx_valid = false;
+			// the index of the next frame of the group to deliver
+			uint8_t fec_rx_next = 0;
 	};
 
 }
@@ -0,0 +1,172 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "fd_transport.h"
+
+#ifdef __unix__
+
+#include "socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+namespace picolan
+{
+
+FdTransport::~FdTransport()
+{
+	close();
+}
+
+int FdTransport::attach(int descriptor, bool f)
+{
+	close();
+	if(descriptor < 0) {
+		return Error::IO;
+	}
+
+	int flags = fcntl(descriptor, F_GETFL);
+	if((flags < 0) || (fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) != 0)) {
+		::close(descriptor);
+		return Error::IO;
+	}
+	fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+
+	struct stat st;
+	socket = (fstat(descriptor, &st) == 0) && S_ISSOCK(st.st_mode);
+	framed = f;
+	fd = descriptor;
+	return Error::NONE;
+}
+
+void FdTransport::close()
+{
+	if(fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+int FdTransport::read(uint8_t* buffer, uint32_t len)
+{
+	if(fd < 0) {
+		return Error::IO;
+	}
+	while(true) {
+		ssize_t r = ::read(fd, buffer, len);
+		if(r > 0) {
+			return r;
+		}
+		// end of file on a stream means the other end has gone
+		if(r == 0) {
+			if(framed || (len == 0)) {
+				return 0;
+			}
+			close();
+			return Error::IO;
+		}
+		if(errno == EINTR) {
+			continue;
+		}
+		if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			return 0;
+		}
+		close();
+		return Error::IO;
+	}
+}
+
+int FdTransport::write(const uint8_t* buffer, uint32_t len)
+{
+	uint32_t pos = 0;
+	while(pos < len) {
+		if(fd < 0) {
+			return Error::IO;
+		}
+
+		// sockets use send() so a closed peer is an error rather than SIGPIPE
+		ssize_t r;
+		if(socket) {
+			r = ::send(fd, buffer + pos, len - pos, MSG_NOSIGNAL);
+		} else {
+			r = ::write(fd, buffer + pos, len - pos);
+		}
+
+		if(r >= 0) {
+			// a message is sent whole or not at all
+			if(framed) {
+				return r;
+			}
+			pos += r;
+			continue;
+		}
+		if(errno == EINTR) {
+			continue;
+		}
+		if((errno == ECONNREFUSED) && framed) {
+			// nobody is listening at the other end yet, so the frame is lost like any other
+			return 0;
+		}
+		if((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+			close();
+			return Error::IO;
+		}
+		struct pollfd p;
+		p.fd = fd;
+		p.events = POLLOUT;
+		if((poll(&p, 1, -1) < 0) && (errno != EINTR)) {
+			close();
+			return Error::IO;
+		}
+	}
+	return pos;
+}
+
+uint32_t FdTransport::available()
+{
+	int n = 0;
+	if((fd < 0) || (ioctl(fd, FIONREAD, &n) != 0) || (n < 0)) {
+		return 0;
+	}
+	if(n == 0) {
+		// FIONREAD can't see a hang up or an empty message, but a read will
+		struct pollfd p;
+		p.fd = fd;
+		p.events = POLLIN;
+		return (poll(&p, 1, 0) > 0) ? 1 : 0;
+	}
+	return n;
+}
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_FD_TRANSPORT_H
+#define PICOLAN_FD_TRANSPORT_H
+
+#ifdef __unix__
+
+#include "transport.h"
+
+namespace picolan
+{
+
+	/**
+	 * FdTransport is the base of transports backed by a POSIX file descriptor, such as
+	 * serial ports and sockets. The descriptor is non-blocking: reads return what is waiting
+	 * and writes wait with poll() only when the kernel buffer is full.
+	 * If the other end goes away or the descriptor fails, it is closed and is_open() returns false.
+	 */
+	class FdTransport : public Transport
+	{
+		public:
+			FdTransport() { }
+			~FdTransport();
+
+			FdTransport(const FdTransport&) = delete;
+			FdTransport& operator=(const FdTransport&) = delete;
+
+			void close();
+
+			bool is_open() const {
+				return fd >= 0;
+			}
+
+			int read(uint8_t* buffer, uint32_t len);
+			int write(const uint8_t* buffer, uint32_t len);
+			uint32_t available();
+
+			bool is_framed() const {
+				return framed;
+			}
+
+			int get_fd() const {
+				return fd;
+			}
+
+		protected:
+			friend class TransportListener;
+
+			/**
+			 * \brief takes ownership of a descriptor and makes it non-blocking.
+			 * @param framed true if the descriptor keeps message boundaries and carries one frame per message
+			 * \return Error::NONE or Error::IO, in which case the descriptor is closed
+			 */
+			int attach(int descriptor, bool framed);
+
+			int fd = -1;
+
+		private:
+			bool framed = false;
+			bool socket = false;
+	};
+
+}
+
+#endif
+
+#endif
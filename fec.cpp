@@ -0,0 +1,149 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#include "fec.h"
+
+namespace picolan
+{
+
+constexpr uint8_t Fec::MAX_GROUP;
+constexpr uint32_t Fec::MAX_FRAME;
+constexpr uint32_t Fec::SLOTS;
+
+void Fec::reset_encoder(uint8_t first)
+{
+	enc_first = first;
+	enc_count = 0;
+	enc_len_xor = 0;
+	enc_max = 0;
+	for(uint32_t i = 0; i < MAX_FRAME; i++) {
+		enc_parity[i] = 0;
+	}
+}
+
+void Fec::add(const uint8_t* data, uint32_t len)
+{
+	if(len > MAX_FRAME) {
+		len = MAX_FRAME;
+	}
+	for(uint32_t i = 0; i < len; i++) {
+		enc_parity[i] ^= data[i];
+	}
+	if(len > enc_max) {
+		enc_max = len;
+	}
+	enc_len_xor ^= len;
+	enc_count++;
+}
+
+void Fec::reset_decoder()
+{
+	for(uint32_t i = 0; i < SLOTS; i++) {
+		slots[i].valid = false;
+	}
+}
+
+void Fec::store(uint8_t id, const uint8_t* data, uint32_t len)
+{
+	if(len > MAX_FRAME) {
+		len = MAX_FRAME;
+	}
+	Slot& s = slots[id % SLOTS];
+	s.valid = true;
+	s.id = id;
+	s.len = len;
+	for(uint32_t i = 0; i < len; i++) {
+		s.data[i] = data[i];
+	}
+}
+
+bool Fec::has(uint8_t id) const
+{
+	const Slot& s = slots[id % SLOTS];
+	return s.valid && (s.id == id);
+}
+
+const uint8_t* Fec::data(uint8_t id, uint32_t& len) const
+{
+	const Slot& s = slots[id % SLOTS];
+	len = s.len;
+	return s.data;
+}
+
+void Fec::release(uint8_t id)
+{
+	Slot& s = slots[id % SLOTS];
+	if(s.id == id) {
+		s.valid = false;
+	}
+}
+
+bool Fec::recover(uint8_t first, uint8_t count, uint8_t len_xor,
+		const uint8_t* parity, uint32_t plen, uint8_t& id)
+{
+	if((count == 0) || (count > MAX_GROUP) || (plen > MAX_FRAME)) {
+		return false;
+	}
+
+	uint8_t missing = 0;
+	for(uint8_t i = 0; i < count; i++) {
+		if(!has(first+i)) {
+			id = first+i;
+			missing++;
+		}
+	}
+	if(missing != 1) {
+		return false;
+	}
+
+	Slot& r = slots[id % SLOTS];
+	uint8_t len = len_xor;
+	for(uint32_t i = 0; i < plen; i++) {
+		r.data[i] = parity[i];
+	}
+	for(uint8_t i = 0; i < count; i++) {
+		uint8_t other = first+i;
+		if(other == id) {
+			continue;
+		}
+		const Slot& s = slots[other % SLOTS];
+		len ^= s.len;
+		for(uint32_t j = 0; j < s.len; j++) {
+			r.data[j] ^= s.data[j];
+		}
+	}
+
+	if(len > plen) {
+		r.valid = false;
+		return false;
+	}
+	r.valid = true;
+	r.id = id;
+	r.len = len;
+	return true;
+}
+
+}
@@ -0,0 +1,188 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#ifndef PICOLAN_FEC_H
+#define PICOLAN_FEC_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "config.h"
+
+namespace picolan
+{
+
+	// the smallest power of two of at least n and at least 8, so ids still map to slots when they wrap
+	constexpr uint32_t fec_slots(uint32_t n, uint32_t p = 8) {
+		return (p >= n) ? p : fec_slots(n, p*2);
+	}
+
+	/**
+	 * Fec holds the state for XOR forward error correction on one socket.
+	 * The sender follows every group of up to k frames with a parity frame that is the
+	 * XOR of the group. If exactly one frame of a group is lost, the receiver rebuilds it
+	 * from the parity frame and the rest of the group without waiting for a retransmit.
+	 *
+	 * An Fec object is given to a socket with Socket::set_fec(). The socket uses it both to
+	 * build outgoing parity and to hold received frames until their group is complete.
+	 *
+	 * Frames are identified by an 8-bit id. Streams use the sequence number and datagrams
+	 * use the position of the frame in its group.
+	 */
+	class Fec
+	{
+		public:
+			/**
+			 * \brief the largest group size
+			 */
+			static constexpr uint8_t MAX_GROUP = 8;
+
+			/**
+			 * \brief the largest frame that can be protected, which is the data a stream frame carries
+			 */
+			static constexpr uint32_t MAX_FRAME = Config::MAX_PACKET_LENGTH-12;
+
+			/**
+			 * \brief the number of frames held. A stream keeps its last MAX_GROUP/2 delivered frames
+			 * for parity while holding up to FRAME_BURST frames that arrived early, and each needs a slot.
+			 */
+			static constexpr uint32_t SLOTS = fec_slots(MAX_GROUP/2 + Config::FRAME_BURST);
+
+			Fec() {
+				reset_encoder(0);
+				reset_decoder();
+			}
+
+			/**
+			 * \brief starts a new parity group
+			 * @param first the id of the first frame in the group
+			 */
+			void reset_encoder(uint8_t first);
+
+			/**
+			 * \brief adds a frame to the parity group
+			 */
+			void add(const uint8_t* data, uint32_t len);
+
+			/**
+			 * \brief returns the number of frames in the parity group
+			 */
+			uint8_t count() const {
+				return enc_count;
+			}
+
+			/**
+			 * \brief returns the id of the first frame in the parity group
+			 */
+			uint8_t first() const {
+				return enc_first;
+			}
+
+			/**
+			 * \brief returns the XOR of the lengths of the frames in the group
+			 */
+			uint8_t len_xor() const {
+				return enc_len_xor;
+			}
+
+			/**
+			 * \brief returns the parity bytes. parity_len() bytes are valid.
+			 */
+			const uint8_t* parity() const {
+				return enc_parity;
+			}
+
+			/**
+			 * \brief returns the length of the longest frame in the group
+			 */
+			uint8_t parity_len() const {
+				return enc_max;
+			}
+
+			/**
+			 * \brief forgets every received frame
+			 */
+			void reset_decoder();
+
+			/**
+			 * \brief keeps a copy of a received frame
+			 */
+			void store(uint8_t id, const uint8_t* data, uint32_t len);
+
+			/**
+			 * \brief returns true if the frame with this id is held
+			 */
+			bool has(uint8_t id) const;
+
+			/**
+			 * \brief returns a held frame
+			 * @param id the frame id
+			 * @param len set to the length of the frame
+			 */
+			const uint8_t* data(uint8_t id, uint32_t& len) const;
+
+			/**
+			 * \brief forgets a held frame
+			 */
+			void release(uint8_t id);
+
+			/**
+			 * \brief rebuilds the one missing frame of a group from its parity.
+			 * The rebuilt frame is held as if it had been received.
+			 * @param first the id of the first frame in the group
+			 * @param count the number of frames in the group
+			 * @param len_xor the XOR of the frame lengths
+			 * @param parity the parity bytes
+			 * @param plen the number of parity bytes
+			 * @param id set to the id of the rebuilt frame
+			 * \return true if a frame was rebuilt. False if none or more than one frame is missing.
+			 */
+			bool recover(uint8_t first, uint8_t count, uint8_t len_xor,
+					const uint8_t* parity, uint32_t plen, uint8_t& id);
+
+		private:
+			struct Slot {
+				bool valid;
+				uint8_t id;
+				uint8_t len;
+				uint8_t data[MAX_FRAME];
+			};
+
+			Slot slots[SLOTS];
+
+			uint8_t enc_first;
+			uint8_t enc_count;
+			uint8_t enc_len_xor;
+			uint8_t enc_max;
+			uint8_t enc_parity[MAX_FRAME];
+	};
+
+}
+
+#endif
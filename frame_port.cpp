@@ -0,0 +1,194 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "frame_port.h"
+
+#ifndef ARDUINO
+
+#include "socket.h"
+
+namespace picolan
+{
+
+void FramePort::attach(Transport& t)
+{
+	link = &t;
+	failed = false;
+	rx_pos = 0;
+	rx_len = 0;
+	frame_len = 0;
+	in_frame = false;
+	escape = false;
+}
+
+bool FramePort::check(const uint8_t* f, uint32_t len)
+{
+	if(len < 4) {
+		return false;
+	}
+	uint16 s1 = 0;
+	uint16 s2 = 0;
+	for(uint32_t i = 0; i < len-2; i++) {
+		fletcher_step(s1, s2, f[i]);
+	}
+	return (f[len-2] == s1) && (f[len-1] == s2);
+}
+
+void FramePort::seal(uint8_t* f, uint32_t len)
+{
+	uint16 s1 = 0;
+	uint16 s2 = 0;
+	for(uint32_t i = 0; i < len-2; i++) {
+		fletcher_step(s1, s2, f[i]);
+	}
+	f[len-2] = s1;
+	f[len-1] = s2;
+}
+
+bool FramePort::accept(const uint8_t* f, uint32_t len)
+{
+	if(!check(f, len)) {
+		rx_errors++;
+		return false;
+	}
+	rx_frames++;
+	return true;
+}
+
+int FramePort::read(uint8_t* buffer, uint32_t len)
+{
+	if((link == nullptr) || failed) {
+		return 0;
+	}
+
+	if(link->is_framed()) {
+		while(true) {
+			int r = link->read(buffer, len);
+			if(r < 0) {
+				failed = true;
+			}
+			if(r <= 0) {
+				return 0;
+			}
+			if(accept(buffer, r)) {
+				return r;
+			}
+		}
+	}
+
+	while(true) {
+		if(rx_pos == rx_len) {
+			int r = link->read(rx, sizeof(rx));
+			if(r < 0) {
+				failed = true;
+			}
+			if(r <= 0) {
+				return 0;
+			}
+			rx_pos = 0;
+			rx_len = r;
+		}
+
+		uint8_t b = rx[rx_pos++];
+		if(!escape && (b == 0xAA)) {
+			escape = true;
+			continue;
+		}
+		if(!escape && (b == 0xAB)) {
+			in_frame = true;
+			frame_len = 0;
+		} else if(!escape && (b == 0xAC)) {
+			bool complete = in_frame && (frame_len != 0);
+			in_frame = false;
+			if(complete && accept(frame, frame_len)) {
+				uint32_t n = (frame_len < len) ? frame_len : len;
+				for(uint32_t i = 0; i < n; i++) {
+					buffer[i] = frame[i];
+				}
+				return n;
+			}
+		} else if(in_frame) {
+			if(frame_len < MAX_FRAME_LENGTH) {
+				frame[frame_len++] = b;
+			} else {
+				in_frame = false;
+				rx_errors++;
+			}
+		}
+		escape = false;
+	}
+}
+
+int FramePort::write(const uint8_t* f, uint32_t len)
+{
+	if((link == nullptr) || failed) {
+		return Error::IO;
+	}
+
+	int r;
+	if(link->is_framed()) {
+		r = link->write(f, len);
+	} else {
+		uint8_t out[2*MAX_FRAME_LENGTH + 2];
+		uint32_t n = 0;
+		out[n++] = 0xAB;
+		for(uint32_t i = 0; (i < len) && (i < MAX_FRAME_LENGTH); i++) {
+			if((f[i] >= 0xAA) && (f[i] <= 0xAC)) {
+				out[n++] = 0xAA;
+			}
+			out[n++] = f[i];
+		}
+		out[n++] = 0xAC;
+		r = link->write(out, n);
+	}
+
+	if(r < 0) {
+		failed = true;
+		return Error::IO;
+	}
+	tx_frames++;
+	return Error::NONE;
+}
+
+uint32_t FramePort::available()
+{
+	if((link == nullptr) || failed) {
+		return 0;
+	}
+	return (rx_len - rx_pos) + link->available();
+}
+
+void FramePort::flush()
+{
+	if((link != nullptr) && !failed) {
+		link->flush();
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_FRAME_PORT_H
+#define PICOLAN_FRAME_PORT_H
+
+#ifndef ARDUINO
+
+#include "transport.h"
+#include "serialiser.h"
+
+namespace picolan
+{
+
+	/**
+	 * FramePort reads and writes whole frames on a transport for code that handles frames
+	 * without an Interface, such as a bond or a switch. Frames on byte stream transports are
+	 * stuffed and unstuffed here. A frame is the id, size, body and checksum, as passed to
+	 * ParserSerialiser::emit_frame().
+	 *
+	 * Frames that fail their checksum are dropped and counted, so everything read() returns
+	 * is intact. If the transport reports an error, the port is marked failed and stops using it.
+	 */
+	class FramePort
+	{
+		public:
+			void attach(Transport& t);
+
+			Transport* get_link() const {
+				return link;
+			}
+
+			bool is_failed() const {
+				return failed;
+			}
+
+			/**
+			 * \brief reads the next good frame without waiting.
+			 * \return the length of the frame, or zero if there isn't a whole frame yet
+			 */
+			int read(uint8_t* frame, uint32_t len);
+
+			/**
+			 * \brief writes a frame.
+			 * \return Error::NONE or Error::IO
+			 */
+			int write(const uint8_t* frame, uint32_t len);
+
+			/**
+			 * \brief returns the number of bytes waiting, whether already read from the transport or not.
+			 */
+			uint32_t available();
+
+			void flush();
+
+			uint32_t get_rx_frames() const {
+				return rx_frames;
+			}
+
+			uint32_t get_rx_errors() const {
+				return rx_errors;
+			}
+
+			uint32_t get_tx_frames() const {
+				return tx_frames;
+			}
+
+			/**
+			 * \brief returns true if a frame is long enough and its checksum is right.
+			 */
+			static bool check(const uint8_t* frame, uint32_t len);
+
+			/**
+			 * \brief writes the checksum into the last two bytes of a frame, such as after changing its ttl.
+			 */
+			static void seal(uint8_t* frame, uint32_t len);
+
+		private:
+			bool accept(const uint8_t* frame, uint32_t len);
+
+			Transport* link = nullptr;
+			bool failed = false;
+
+			// bytes read from a byte stream and the frame being unstuffed from them
+			uint8_t rx[256];
+			uint32_t rx_pos = 0;
+			uint32_t rx_len = 0;
+			uint8_t frame[MAX_FRAME_LENGTH];
+			uint8_t frame_len = 0;
+			bool in_frame = false;
+			bool escape = false;
+
+			uint32_t rx_frames = 0;
+			uint32_t rx_errors = 0;
+			uint32_t tx_frames = 0;
+	};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "histogram.h"
+
+namespace picolan
+{
+
+constexpr uint32_t Histogram::SUB_BITS;
+constexpr uint32_t Histogram::SUB_BUCKETS;
+constexpr uint32_t Histogram::BUCKETS;
+
+void Histogram::record(uint32_t value)
+{
+	counts[index_of(value)]++;
+	if((total == 0) || (value < lowest)) {
+		lowest = value;
+	}
+	if(value > highest) {
+		highest = value;
+	}
+	total++;
+	sum += value;
+}
+
+void Histogram::merge(const Histogram& other)
+{
+	if(other.total == 0) {
+		return;
+	}
+	for(uint32_t i = 0; i < BUCKETS; i++) {
+		counts[i] += other.counts[i];
+	}
+	if((total == 0) || (other.lowest < lowest)) {
+		lowest = other.lowest;
+	}
+	if(other.highest > highest) {
+		highest = other.highest;
+	}
+	total += other.total;
+	sum += other.sum;
+}
+
+void Histogram::reset()
+{
+	for(uint32_t i = 0; i < BUCKETS; i++) {
+		counts[i] = 0;
+	}
+	total = 0;
+	lowest = 0;
+	highest = 0;
+	sum = 0;
+}
+
+uint32_t Histogram::percentile(float p) const
+{
+	if(total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)((p / 100.0f) * total + 0.5f);
+	if(rank < 1) {
+		rank = 1;
+	}
+	if(rank > total) {
+		rank = total;
+	}
+
+	uint64_t seen = 0;
+	for(uint32_t i = 0; i < BUCKETS; i++) {
+		seen += counts[i];
+		if(seen >= rank) {
+			uint32_t v = highest_in(i);
+			if(v > highest) {
+				v = highest;
+			}
+			if(v < lowest) {
+				v = lowest;
+			}
+			return v;
+		}
+	}
+	return highest;
+}
+
+uint32_t Histogram::index_of(uint32_t value)
+{
+	// values below two sub-bucket ranges have a bucket each
+	if(value < (SUB_BUCKETS << 1)) {
+		return value;
+	}
+
+	uint32_t msb = 31;
+	while((value & (1u << msb)) == 0) {
+		msb--;
+	}
+	uint32_t shift = msb - SUB_BITS;
+	return shift*SUB_BUCKETS + (value >> shift);
+}
+
+uint32_t Histogram::highest_in(uint32_t index)
+{
+	if(index < (SUB_BUCKETS << 1)) {
+		return index;
+	}
+
+	uint32_t shift = index/SUB_BUCKETS - 1;
+	uint32_t m = index - shift*SUB_BUCKETS;
+	return (uint32_t)((((uint64_t)m + 1) << shift) - 1);
+}
+
+}
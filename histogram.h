@@ -0,0 +1,118 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_HISTOGRAM_H
+#define PICOLAN_HISTOGRAM_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+namespace picolan
+{
+
+	/**
+	 * Histogram records a distribution of values, such as latencies in microseconds, in a
+	 * fixed amount of memory. Buckets are log-linear: each power of two range is split into
+	 * 2^SUB_BITS equal buckets, so any recorded value is known to within 1/2^SUB_BITS of itself
+	 * (12.5%) across the whole 32 bit range. The exact minimum, maximum and mean are also kept.
+	 */
+	class Histogram
+	{
+		public:
+			static constexpr uint32_t SUB_BITS = 3;
+			static constexpr uint32_t SUB_BUCKETS = (1u << SUB_BITS);
+			static constexpr uint32_t BUCKETS = (32 - SUB_BITS + 1) * SUB_BUCKETS;
+
+			Histogram() {
+				reset();
+			}
+
+			/**
+			 * \brief records one value.
+			 */
+			void record(uint32_t value);
+
+			/**
+			 * \brief adds every value recorded in another histogram.
+			 */
+			void merge(const Histogram& other);
+
+			/**
+			 * \brief clears the histogram.
+			 */
+			void reset();
+
+			/**
+			 * \brief returns the number of values recorded.
+			 */
+			uint32_t count() const {
+				return total;
+			}
+
+			uint32_t min() const {
+				return total ? lowest : 0;
+			}
+
+			uint32_t max() const {
+				return highest;
+			}
+
+			uint32_t mean() const {
+				return total ? (uint32_t)(sum / total) : 0;
+			}
+
+			/**
+			 * \brief returns the sum of every value recorded.
+			 */
+			uint64_t get_sum() const {
+				return sum;
+			}
+
+			/**
+			 * \brief returns the value that the given percentage of recorded values are at or below.
+			 * The result is the upper end of the bucket it falls in, limited to the largest value recorded.
+			 * @param p a percentage from 0 to 100, such as 99.9
+			 */
+			uint32_t percentile(float p) const;
+
+		private:
+			static uint32_t index_of(uint32_t value);
+			static uint32_t highest_in(uint32_t index);
+
+			uint32_t counts[BUCKETS];
+			uint32_t total;
+			uint32_t lowest;
+			uint32_t highest;
+			uint64_t sum;
+	};
+
+}
+
+#endif
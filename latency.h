@@ -0,0 +1,97 @@
+#ifndef PICOLAN_LATENCY_H
+#define PICOLAN_LATENCY_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "ulan_time.h"
+#include "histogram.h"
+
+namespace picolan
+{
+
+/**
+ * The operations that latency is measured for when PICOLAN_LATENCY_STATS is defined.
+ */
+enum LATENCY_OP : uint8_t
+{
+	/** Client::connect(), from sending the SYN until the connection is open */
+	LATENCY_CONNECT,
+	/** Server::accept(), from replying to the SYN until the connection is open */
+	LATENCY_ACCEPT,
+	/** SocketStream::write(), from the first byte being sent until the last is acknowledged */
+	LATENCY_WRITE,
+	/** time spent waiting in Socket::read() */
+	LATENCY_READ,
+	/** decoding a received frame and delivering it to its socket */
+	LATENCY_DECODE,
+	NUM_LATENCY_OPS
+};
+
+/**
+ * LatencyStats keeps a histogram of microseconds per operation.
+ * Each histogram takes about 1kB, so this is only compiled in when PICOLAN_LATENCY_STATS
+ * is defined. Every socket keeps its own, and the interface keeps the aggregate of all of them.
+ */
+class LatencyStats
+{
+public:
+	void record(uint8_t op, uint32_t us) {
+		if(op < NUM_LATENCY_OPS) {
+			hist[op].record(us);
+		}
+	}
+
+	const Histogram& get(uint8_t op) const {
+		return hist[(op < NUM_LATENCY_OPS) ? op : (uint8_t)LATENCY_DECODE];
+	}
+
+	void merge(const LatencyStats& other) {
+		for(uint8_t i = 0; i < NUM_LATENCY_OPS; i++) {
+			hist[i].merge(other.hist[i]);
+		}
+	}
+
+	void reset() {
+		for(uint8_t i = 0; i < NUM_LATENCY_OPS; i++) {
+			hist[i].reset();
+		}
+	}
+
+	/**
+	 * \brief returns a short lower case name for an operation, such as "write".
+	 */
+	static const char* op_name(uint8_t op) {
+		switch(op) {
+			case LATENCY_CONNECT: return "connect";
+			case LATENCY_ACCEPT: return "accept";
+			case LATENCY_WRITE: return "write";
+			case LATENCY_READ: return "read";
+			case LATENCY_DECODE: return "decode";
+		}
+		return "unknown";
+	}
+
+private:
+	Histogram hist[NUM_LATENCY_OPS];
+};
+
+/**
+ * \brief returns the time to measure a latency from, or zero without PICOLAN_LATENCY_STATS
+ * so that the clock isn't read when nothing is recorded.
+ */
+inline uint64_t latency_clock()
+{
+	#ifdef PICOLAN_LATENCY_STATS
+	return now_us();
+	#else
+	return 0;
+	#endif
+}
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "linux_serial.h"
+
+#ifdef __linux__
+
+#include "socket.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+// termios2 lives in the kernel headers, which can't be included alongside <termios.h>
+#include <asm/termbits.h>
+#include <asm/ioctls.h>
+
+namespace picolan
+{
+
+int LinuxSerial::open(const std::string& path, uint32_t baud, bool rtscts)
+{
+	if(attach(::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC), false) != Error::NONE) {
+		return Error::IO;
+	}
+
+	struct termios2 tio;
+	if(ioctl(fd, TCGETS2, &tio) != 0) {
+		close();
+		return Error::IO;
+	}
+
+	// raw mode, the same as cfmakeraw()
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+	tio.c_cflag |= CS8 | CREAD | CLOCAL;
+	if(rtscts) {
+		tio.c_cflag |= CRTSCTS;
+	}
+
+	// reads return immediately with whatever has arrived
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+
+	if(ioctl(fd, TCSETS2, &tio) != 0) {
+		close();
+		return Error::IO;
+	}
+
+	// not every driver has a low latency mode, so failure here isn't an error
+	struct serial_struct ss;
+	if(ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+		ss.flags |= ASYNC_LOW_LATENCY;
+		ioctl(fd, TIOCSSERIAL, &ss);
+	}
+
+	// throw away anything left over from a previous user of the port
+	ioctl(fd, TCFLSH, TCIOFLUSH);
+	return Error::NONE;
+}
+
+int LinuxSerial::set_baud(uint32_t baud)
+{
+	struct termios2 tio;
+	if((fd < 0) || (ioctl(fd, TCGETS2, &tio) != 0)) {
+		return Error::IO;
+	}
+	tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+	if(ioctl(fd, TCSETS2, &tio) != 0) {
+		return Error::IO;
+	}
+	return Error::NONE;
+}
+
+void LinuxSerial::drain()
+{
+	if(fd >= 0) {
+		ioctl(fd, TCSBRK, 1);
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_LINUX_SERIAL_H
+#define PICOLAN_LINUX_SERIAL_H
+
+#ifdef __linux__
+
+#include <string>
+#include "fd_transport.h"
+
+namespace picolan
+{
+
+	/**
+	 * LinuxSerial is a Transport for a serial port on Linux.
+	 * The port is put in raw mode with non-blocking I/O, so reads return whatever has arrived
+	 * in one system call. Any baud rate the hardware supports can be used, including the
+	 * 3 to 12 Mbaud rates of USB UART bridges, because the rate is set with termios2 and BOTHER
+	 * rather than the fixed Bxxx constants. The driver's low latency flag is set where it is supported.
+	 *
+	 * \code
+	 * LinuxSerial port;
+	 * if(port.open("/dev/ttyUSB0", 3000000) != Error::NONE) {
+	 *     ...
+	 * }
+	 * Interface iface(port);
+	 * \endcode
+	 */
+	class LinuxSerial : public FdTransport
+	{
+		public:
+			LinuxSerial() { }
+
+			/**
+			 * \brief opens and configures a serial port, 8N1.
+			 * @param path the device, such as /dev/ttyUSB0
+			 * @param baud the baud rate in bits per second
+			 * @param rtscts true to enable hardware flow control
+			 * \return Error::NONE or Error::IO
+			 */
+			int open(const std::string& path, uint32_t baud, bool rtscts = false);
+
+			/**
+			 * \brief changes the baud rate of an open port.
+			 * \return Error::NONE or Error::IO
+			 */
+			int set_baud(uint32_t baud);
+
+			/**
+			 * \brief waits until every byte written has left the UART.
+			 * This isn't needed for normal operation, writes are sent as soon as they're made.
+			 */
+			void drain();
+	};
+
+}
+
+#endif
+
+#endif
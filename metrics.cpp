@@ -0,0 +1,207 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "metrics.h"
+
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <vector>
+
+namespace picolan
+{
+
+namespace
+{
+
+void metric(std::string& out, const char* name, const char* help, const char* type)
+{
+	out += "# HELP ";
+	out += name;
+	out += " ";
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += " ";
+	out += type;
+	out += "\n";
+}
+
+void sample(std::string& out, const char* name, const std::string& labels, uint64_t value)
+{
+	out += name;
+	out += "{";
+	out += labels;
+	out += "} ";
+	out += std::to_string(value);
+	out += "\n";
+}
+
+#ifdef PICOLAN_LATENCY_STATS
+// the tail is what matters, averages hide retransmit timeouts
+const float QUANTILES[] = {50.0f, 90.0f, 99.0f, 99.9f};
+
+void summary(std::string& out, const char* name, const std::string& labels, const LatencyStats& stats)
+{
+	for(uint8_t op = 0; op < NUM_LATENCY_OPS; op++) {
+		const Histogram& h = stats.get(op);
+		if(h.count() == 0) {
+			continue;
+		}
+		std::string l = labels + ",op=\"" + LatencyStats::op_name(op) + "\"";
+		for(float q : QUANTILES) {
+			char quantile[16];
+			snprintf(quantile, sizeof(quantile), "%g", q/100.0f);
+			sample(out, name, l + ",quantile=\"" + quantile + "\"", h.percentile(q));
+		}
+		sample(out, (std::string(name) + "_sum").c_str(), l, h.get_sum());
+		sample(out, (std::string(name) + "_count").c_str(), l, h.count());
+	}
+}
+#endif
+
+}
+
+MetricsExporter::MetricsExporter(Interface& iface, const std::string& path, const std::string& name)
+	: iface(iface), path(path), name(name), tick(&MetricsExporter::on_tick, this)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	stop();
+}
+
+void MetricsExporter::start(uint32_t interval_ms)
+{
+	interval = (interval_ms != 0) ? interval_ms : 1;
+	write();
+	iface.get_timers().schedule(tick, interval);
+}
+
+void MetricsExporter::stop()
+{
+	tick.cancel();
+}
+
+std::string MetricsExporter::format()
+{
+	LinkStats link = iface.get_link_stats();
+	std::vector<SocketStats> sockets(Interface::MAX_SOCKET_STATS);
+	uint32_t n = iface.get_socket_stats(sockets.data(), sockets.size());
+	if(n < sockets.size()) {
+		sockets.resize(n);
+	}
+
+	std::string labels = "interface=\"" + name + "\",address=\"" + std::to_string(iface.get_address()) + "\"";
+	std::string out;
+
+	struct LinkMetric {
+		const char* name;
+		const char* help;
+		uint32_t value;
+	};
+	const LinkMetric link_metrics[] = {
+		{"picolan_rx_frames_total", "Frames received with a good checksum.", link.rx_frames},
+		{"picolan_rx_bytes_total", "Bytes read from the link.", link.rx_bytes},
+		{"picolan_checksum_errors_total", "Frames dropped because of a bad checksum.", link.checksum_errors},
+		{"picolan_resyncs_total", "Partial frames abandoned by the parser.", link.resyncs},
+		{"picolan_tx_frames_total", "Frames written to the link.", link.tx_frames},
+		{"picolan_tx_bytes_total", "Bytes written to the link.", link.tx_bytes},
+		{"picolan_tx_escapes_total", "Escape bytes added to outgoing frames.", link.tx_escapes},
+	};
+	for(auto& m : link_metrics) {
+		metric(out, m.name, m.help, "counter");
+		sample(out, m.name, labels, m.value);
+	}
+
+	struct SocketMetric {
+		const char* name;
+		const char* help;
+		uint32_t SocketStats::*value;
+	};
+	const SocketMetric socket_metrics[] = {
+		{"picolan_socket_rx_frames_total", "Frames addressed to the socket.", &SocketStats::rx_frames},
+		{"picolan_socket_rx_bytes_total", "Bytes delivered to the socket receive buffer.", &SocketStats::rx_bytes},
+		{"picolan_socket_rx_overflows_total", "Bytes dropped because the receive buffer was full.", &SocketStats::rx_overflows},
+		{"picolan_socket_retransmits_total", "Stream frames sent again.", &SocketStats::retransmits},
+		{"picolan_socket_timeouts_total", "Writes and connections that timed out.", &SocketStats::timeouts},
+	};
+	for(auto& m : socket_metrics) {
+		metric(out, m.name, m.help, "counter");
+		for(auto& s : sockets) {
+			std::string l = labels + ",port=\"" + std::to_string(s.port)
+				+ "\",remote=\"" + std::to_string(s.remote) + "\"";
+			sample(out, m.name, l, s.*m.value);
+		}
+	}
+	#ifdef PICOLAN_LATENCY_STATS
+	metric(out, "picolan_latency_us", "Latency of socket operations on the interface in microseconds.", "summary");
+	summary(out, "picolan_latency_us", labels, iface.get_latency());
+
+	metric(out, "picolan_socket_latency_us", "Latency of operations on a socket in microseconds.", "summary");
+	for(uint32_t i = 0; i < sockets.size(); i++) {
+		Socket* s = iface.get_socket(i);
+		if(s == nullptr) {
+			break;
+		}
+		std::string l = labels + ",port=\"" + std::to_string(sockets[i].port)
+			+ "\",remote=\"" + std::to_string(sockets[i].remote) + "\"";
+		summary(out, "picolan_socket_latency_us", l, s->get_latency());
+	}
+	#endif
+	return out;
+}
+
+bool MetricsExporter::write()
+{
+	std::string text = format();
+	std::string tmp = path + ".tmp";
+
+	FILE* f = fopen(tmp.c_str(), "w");
+	if(f == nullptr) {
+		return false;
+	}
+	bool ok = (fwrite(text.data(), 1, text.size(), f) == text.size());
+	ok = (fclose(f) == 0) && ok;
+	if(!ok || (rename(tmp.c_str(), path.c_str()) != 0)) {
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+void MetricsExporter::on_tick(void* e)
+{
+	MetricsExporter* me = (MetricsExporter*)e;
+	me->write();
+	me->iface.get_timers().schedule(me->tick, me->interval);
+}
+
+}
+
+#endif
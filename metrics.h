@@ -0,0 +1,96 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_METRICS_H
+#define PICOLAN_METRICS_H
+
+#ifndef ARDUINO
+
+#include <string>
+#include "picolan.h"
+
+namespace picolan
+{
+
+	/**
+	 * MetricsExporter periodically writes the counters of an interface and its sockets to a file
+	 * in the Prometheus text exposition format, for example for node_exporter's textfile collector.
+	 * The file is written to a temporary name and renamed into place so a reader never sees
+	 * half a file. Writes happen on the timer wheel, so the interface must be serviced.
+	 * When PICOLAN_LATENCY_STATS is defined, latency percentiles are written as summaries.
+	 * This is only available on hosts.
+	 */
+	class MetricsExporter
+	{
+		public:
+			/**
+			 * @param iface the interface to export
+			 * @param path the file to write
+			 * @param name the value of the interface label on every metric
+			 */
+			MetricsExporter(Interface& iface, const std::string& path, const std::string& name = "picolan");
+			~MetricsExporter();
+
+			MetricsExporter(const MetricsExporter&) = delete;
+			MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+			/**
+			 * \brief writes the file every interval_ms milliseconds, starting now.
+			 */
+			void start(uint32_t interval_ms);
+
+			/**
+			 * \brief stops writing the file.
+			 */
+			void stop();
+
+			/**
+			 * \brief writes the file now.
+			 * \return false if the file couldn't be written
+			 */
+			bool write();
+
+			/**
+			 * \brief formats the current counters as Prometheus text.
+			 */
+			std::string format();
+
+		private:
+			static void on_tick(void* e);
+
+			Interface& iface;
+			std::string path;
+			std::string name;
+			uint32_t interval = 0;
+			Timer tick;
+	};
+
+}
+
+#endif
+
+#endif
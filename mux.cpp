@@ -0,0 +1,264 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#include "mux.h"
+#include "picolan.h"
+
+namespace picolan
+{
+
+constexpr uint8_t Multiplexer::MAX_STREAMS;
+constexpr uint32_t Multiplexer::HEADER_SZ;
+constexpr uint8_t Multiplexer::SEG_DATA;
+constexpr uint8_t Multiplexer::SEG_WINDOW;
+
+// a header and a full segment fill one stream frame
+constexpr uint32_t SEGMENT_SZ = SocketStream::BYTES_PER_FRAME-4;
+
+static uint32_t min(uint32_t a, uint32_t b)
+{
+	return (a < b) ? a : b;
+}
+
+MuxStream::~MuxStream()
+{
+	if(mux != nullptr) {
+		mux->detach(*this);
+	}
+}
+
+uint32_t MuxStream::available()
+{
+	return rx.available();
+}
+
+uint32_t MuxStream::read(uint8_t* buffer, uint32_t len)
+{
+	uint32_t n = min(len, rx.available());
+	for(uint32_t i = 0; i < n; i++) {
+		buffer[i] = rx.get();
+	}
+	consumed += n;
+	return n;
+}
+
+uint32_t MuxStream::writable()
+{
+	return tx_len - tx.available();
+}
+
+uint32_t MuxStream::write(const uint8_t* bytes, uint32_t len)
+{
+	uint32_t n = min(len, writable());
+	for(uint32_t i = 0; i < n; i++) {
+		tx.put(bytes[i]);
+	}
+	return n;
+}
+
+bool Multiplexer::attach(MuxStream& s)
+{
+	if((find(s.id) != nullptr) || (streams.size() == MAX_STREAMS)) {
+		return false;
+	}
+
+	s.mux = this;
+	s.credit = 0;
+	for(uint8_t i = 0; i < n_held; i++) {
+		if(held_ids[i] == s.id) {
+			s.credit = held_credit[i];
+			n_held--;
+			held_ids[i] = held_ids[n_held];
+			held_credit[i] = held_credit[n_held];
+			break;
+		}
+	}
+	// the whole receive buffer is advertised to the remote on the next service
+	s.consumed = s.rx_len;
+	streams.append(&s);
+	return true;
+}
+
+void Multiplexer::detach(MuxStream& s)
+{
+	for(uint32_t i = 0; i < streams.size(); i++) {
+		if(streams[i] == &s) {
+			streams.remove(i);
+		}
+	}
+	if(rx_stream == &s) {
+		rx_stream = nullptr;
+	}
+	s.mux = nullptr;
+}
+
+void Multiplexer::service()
+{
+	receive();
+	transmit();
+}
+
+MuxStream* Multiplexer::find(uint8_t id)
+{
+	for(auto& s : streams) {
+		if(s->id == id) {
+			return s;
+		}
+	}
+	return nullptr;
+}
+
+void Multiplexer::hold_credit(uint8_t id, uint32_t credit)
+{
+	for(uint8_t i = 0; i < n_held; i++) {
+		if(held_ids[i] == id) {
+			held_credit[i] += credit;
+			return;
+		}
+	}
+	if(n_held < MAX_STREAMS) {
+		held_ids[n_held] = id;
+		held_credit[n_held] = credit;
+		n_held++;
+	}
+}
+
+void Multiplexer::receive()
+{
+	uint8_t buf[32];
+	while(stream.available()) {
+		uint32_t n = min(stream.available(), sizeof(buf));
+		#ifndef PICOLAN_NODE_BINDING
+		int r = stream.read(buf, n);
+		#else
+		std::vector<uint8_t> v = stream.read(n);
+		int r = v.size();
+		for(int i = 0; i < r; i++) {
+			buf[i] = v[i];
+		}
+		#endif
+		if(r <= 0) {
+			return;
+		}
+
+		for(int i = 0; i < r; i++) {
+			if(payload_left != 0) {
+				// data for unknown streams is discarded
+				if(rx_stream != nullptr) {
+					rx_stream->rx.put(buf[i]);
+				} else {
+					discarded++;
+				}
+				payload_left--;
+				continue;
+			}
+
+			header[header_pos++] = buf[i];
+			if(header_pos != HEADER_SZ) {
+				continue;
+			}
+			header_pos = 0;
+
+			uint32_t len = header[2] | (header[3] << 8);
+			MuxStream* s = find(header[1]);
+			if(header[0] == SEG_WINDOW) {
+				if(s != nullptr) {
+					s->credit += len;
+				} else {
+					// the remote attached first. window updates are only sent as the
+					// remote reads, so this credit is kept until the stream attaches
+					hold_credit(header[1], len);
+				}
+			}
+			else if(header[0] == SEG_DATA) {
+				rx_stream = s;
+				payload_left = len;
+			}
+		}
+	}
+}
+
+void Multiplexer::transmit()
+{
+	// window updates go first because they are small and keep the remote sending
+	for(auto& s : streams) {
+		uint32_t threshold = (s->rx_len/4 == 0) ? 1 : s->rx_len/4;
+		if(s->consumed >= threshold) {
+			uint32_t n = min(s->consumed, 0xFFFF);
+			if(!send_segment(SEG_WINDOW, *s, n)) {
+				return;
+			}
+			s->consumed -= n;
+		}
+	}
+
+	// then one segment from each stream in turn until nothing can be sent
+	uint32_t count = streams.size();
+	uint32_t idle = 0;
+	while((count != 0) && (idle < count)) {
+		MuxStream* s = streams[next_stream % count];
+		next_stream = (next_stream+1) % count;
+
+		uint32_t n = min(min(s->tx.available(), s->credit), SEGMENT_SZ);
+		if(n == 0) {
+			idle++;
+			continue;
+		}
+		if(!send_segment(SEG_DATA, *s, n)) {
+			return;
+		}
+		idle = 0;
+	}
+}
+
+bool Multiplexer::send_segment(uint8_t type, MuxStream& s, uint32_t n)
+{
+	uint32_t len = HEADER_SZ + ((type == SEG_DATA) ? n : 0);
+	if(stream.writable() < len) {
+		return false;
+	}
+
+	uint8_t buf[HEADER_SZ + SEGMENT_SZ];
+	buf[0] = type;
+	buf[1] = s.id;
+	buf[2] = n & 0xFF;
+	buf[3] = (n >> 8) & 0xFF;
+	if(type == SEG_DATA) {
+		for(uint32_t i = 0; i < n; i++) {
+			buf[HEADER_SZ + i] = s.tx.get();
+		}
+		s.credit -= n;
+	}
+
+	#ifndef PICOLAN_NODE_BINDING
+	stream.write(buf, len);
+	#else
+	stream.write(std::vector<uint8_t>(buf, buf+len));
+	#endif
+	return true;
+}
+
+}
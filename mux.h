@@ -0,0 +1,181 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+#ifndef PICOLAN_MUX_H
+#define PICOLAN_MUX_H
+
+#include "socket_stream.h"
+
+namespace picolan
+{
+
+	class Multiplexer;
+
+	/**
+	 * A MuxStream is one logical byte stream carried by a Multiplexer.
+	 * Each MuxStream has its own receive and send buffers and its own flow control,
+	 * so a slow reader on one stream never blocks the others.
+	 * Both ends of the connection must attach a MuxStream with the same id.
+	 * read() and write() never block. Call Multiplexer::service() to move data.
+	 */
+	class MuxStream
+	{
+		public:
+			/**
+			 * \brief MuxStream constructor
+			 * @param id the stream id. Must match the id used at the other end of the connection.
+			 * @param rxbuf a buffer for received bytes. Its size is the flow control window.
+			 * @param rxlen the length of rxbuf
+			 * @param txbuf a buffer for bytes waiting to be sent
+			 * @param txlen the length of txbuf
+			 */
+			MuxStream(uint8_t id, uint8_t* rxbuf, uint32_t rxlen, uint8_t* txbuf, uint32_t txlen)
+				: id(id), rx(rxbuf, rxlen), rx_len(rxlen), tx(txbuf, txlen), tx_len(txlen)
+			{ }
+
+			~MuxStream();
+
+			/**
+			 * \brief returns the stream id
+			 */
+			uint8_t get_id() const {
+				return id;
+			}
+
+			/**
+			 * \brief returns the number of bytes waiting to be read
+			 */
+			uint32_t available();
+
+			/**
+			 * \brief copies up to len received bytes into buffer
+			 * \return the number of bytes read
+			 */
+			uint32_t read(uint8_t* buffer, uint32_t len);
+
+			/**
+			 * \brief returns the number of bytes that can be written
+			 */
+			uint32_t writable();
+
+			/**
+			 * \brief queues up to len bytes to be sent
+			 * \return the number of bytes queued
+			 */
+			uint32_t write(const uint8_t* bytes, uint32_t len);
+
+		private:
+			friend class Multiplexer;
+
+			uint8_t id;
+			etk::RingBuffer<uint8_t> rx;
+			uint32_t rx_len;
+			etk::RingBuffer<uint8_t> tx;
+			uint32_t tx_len;
+
+			Multiplexer* mux = nullptr;
+			uint32_t credit = 0;        // bytes the remote stream can still accept
+			uint32_t consumed = 0;      // bytes read since the last window update
+	};
+
+
+	/**
+	 * The Multiplexer runs many independent MuxStreams over one open SocketStream.
+	 * This saves a port, a handshake and a set of retransmission timers per channel.
+	 * For example, a control channel, a log channel and a bulk file channel can share one connection.
+	 *
+	 * Streams are served round-robin one segment at a time, so a bulk transfer cannot starve a
+	 * control channel. Each stream is flow controlled by its receiver, which grants the sender
+	 * credit as the application reads.
+	 *
+	 * The SocketStream must be connected and have a send buffer (SocketStream::set_send_buffer()).
+	 * Call Interface::service() and Multiplexer::service() regularly.
+	 */
+	class Multiplexer
+	{
+		public:
+			static constexpr uint8_t MAX_STREAMS = 8;
+
+			Multiplexer(SocketStream& stream) : stream(stream) { }
+
+			/**
+			 * \brief attaches a stream
+			 * The two ends may attach their streams in any order. Credit the remote grants before
+			 * the stream is attached here is held and given to the stream when it attaches.
+			 * \return false if there are too many streams or the id is in use
+			 */
+			bool attach(MuxStream& s);
+
+			/**
+			 * \brief detaches a stream
+			 * Data that arrives for the stream afterwards is discarded, see get_discarded().
+			 */
+			void detach(MuxStream& s);
+
+			/**
+			 * \brief returns the number of received bytes discarded because their stream wasn't attached
+			 */
+			uint32_t get_discarded() const {
+				return discarded;
+			}
+
+			/**
+			 * \brief delivers received segments to their streams and sends queued data
+			 * and window updates.
+			 */
+			void service();
+
+		private:
+			// segment header: type, stream id, length/credit (little endian)
+			static constexpr uint32_t HEADER_SZ = 4;
+			static constexpr uint8_t SEG_DATA = 0;
+			static constexpr uint8_t SEG_WINDOW = 1;
+
+			void receive();
+			void transmit();
+			bool send_segment(uint8_t type, MuxStream& s, uint32_t n);
+			MuxStream* find(uint8_t id);
+			void hold_credit(uint8_t id, uint32_t credit);
+
+			SocketStream& stream;
+			etk::List<MuxStream*, MAX_STREAMS> streams;
+			uint8_t next_stream = 0;
+
+			uint8_t header[HEADER_SZ];
+			uint8_t header_pos = 0;
+			uint32_t payload_left = 0;
+			MuxStream* rx_stream = nullptr;
+			uint32_t discarded = 0;
+
+			// credit granted to streams that aren't attached yet. the remote can't have more
+			// than MAX_STREAMS streams, so this can't run out
+			uint8_t held_ids[MAX_STREAMS];
+			uint32_t held_credit[MAX_STREAMS];
+			uint8_t n_held = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,254 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "net_transport.h"
+
+#ifdef __unix__
+
+#include "socket.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace picolan
+{
+
+namespace
+{
+
+// resolves host and port and runs fn on each address until it returns a descriptor
+template <typename F> int each_address(const std::string& host, uint16_t port, int type, int flags, F fn)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = type;
+	hints.ai_flags = flags;
+
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+
+	struct addrinfo* list;
+	if(getaddrinfo(host.empty() ? nullptr : host.c_str(), service, &hints, &list) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	for(struct addrinfo* a = list; (a != nullptr) && (fd < 0); a = a->ai_next) {
+		fd = fn(a);
+	}
+	freeaddrinfo(list);
+	return fd;
+}
+
+void no_delay(int fd)
+{
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+bool unix_address(const std::string& path, struct sockaddr_un& addr)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path)) {
+		return false;
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+}
+
+int UdpTransport::open(uint16_t local_port, const std::string& host, uint16_t port)
+{
+	int fd = each_address(host, port, SOCK_DGRAM, 0, [local_port](struct addrinfo* a) {
+		int s = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(s < 0) {
+			return -1;
+		}
+
+		struct sockaddr_storage local;
+		memset(&local, 0, sizeof(local));
+		socklen_t local_len;
+		if(a->ai_family == AF_INET6) {
+			struct sockaddr_in6* l = (struct sockaddr_in6*)&local;
+			l->sin6_family = AF_INET6;
+			l->sin6_addr = in6addr_any;
+			l->sin6_port = htons(local_port);
+			local_len = sizeof(*l);
+		} else {
+			struct sockaddr_in* l = (struct sockaddr_in*)&local;
+			l->sin_family = AF_INET;
+			l->sin_addr.s_addr = htonl(INADDR_ANY);
+			l->sin_port = htons(local_port);
+			local_len = sizeof(*l);
+		}
+
+		// connecting a datagram socket filters out everyone but the remote
+		if((bind(s, (struct sockaddr*)&local, local_len) != 0)
+				|| (::connect(s, a->ai_addr, a->ai_addrlen) != 0)) {
+			::close(s);
+			return -1;
+		}
+		return s;
+	});
+	return attach(fd, true);
+}
+
+int TcpTransport::connect(const std::string& host, uint16_t port)
+{
+	int fd = each_address(host, port, SOCK_STREAM, 0, [](struct addrinfo* a) {
+		int s = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(s < 0) {
+			return -1;
+		}
+		if(::connect(s, a->ai_addr, a->ai_addrlen) != 0) {
+			::close(s);
+			return -1;
+		}
+		no_delay(s);
+		return s;
+	});
+	return attach(fd, false);
+}
+
+int UnixTransport::connect(const std::string& path, bool framed)
+{
+	struct sockaddr_un addr;
+	if(!unix_address(path, addr)) {
+		return Error::IO;
+	}
+	int s = ::socket(AF_UNIX, (framed ? SOCK_SEQPACKET : SOCK_STREAM) | SOCK_CLOEXEC, 0);
+	if(s < 0) {
+		return Error::IO;
+	}
+	if(::connect(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		::close(s);
+		return Error::IO;
+	}
+	return attach(s, framed);
+}
+
+TransportListener::~TransportListener()
+{
+	close();
+}
+
+int TransportListener::listen_tcp(uint16_t port, const std::string& host)
+{
+	close();
+	fd = each_address(host, port, SOCK_STREAM, AI_PASSIVE, [](struct addrinfo* a) {
+		int s = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(s < 0) {
+			return -1;
+		}
+		int one = 1;
+		setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if((bind(s, a->ai_addr, a->ai_addrlen) != 0) || (::listen(s, 8) != 0)) {
+			::close(s);
+			return -1;
+		}
+		return s;
+	});
+	tcp = true;
+	framed = false;
+	return (fd >= 0) ? Error::NONE : Error::IO;
+}
+
+int TransportListener::listen_unix(const std::string& path, bool f)
+{
+	close();
+	struct sockaddr_un addr;
+	if(!unix_address(path, addr)) {
+		return Error::IO;
+	}
+	int s = ::socket(AF_UNIX, (f ? SOCK_SEQPACKET : SOCK_STREAM) | SOCK_CLOEXEC, 0);
+	if(s < 0) {
+		return Error::IO;
+	}
+	unlink(path.c_str());
+	if((bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (::listen(s, 8) != 0)) {
+		::close(s);
+		return Error::IO;
+	}
+	fd = s;
+	tcp = false;
+	framed = f;
+	unix_path = path;
+	return Error::NONE;
+}
+
+int TransportListener::accept(FdTransport& transport, uint32_t timeout_ms)
+{
+	if(fd < 0) {
+		return Error::IO;
+	}
+
+	struct pollfd p;
+	p.fd = fd;
+	p.events = POLLIN;
+	int r = poll(&p, 1, timeout_ms);
+	if(r == 0) {
+		return Error::TIMEOUT;
+	}
+	if(r < 0) {
+		return (errno == EINTR) ? Error::TIMEOUT : Error::IO;
+	}
+
+	int s = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+	if(s < 0) {
+		return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? Error::TIMEOUT : Error::IO;
+	}
+	if(tcp) {
+		no_delay(s);
+	}
+	return transport.attach(s, framed);
+}
+
+void TransportListener::close()
+{
+	if(fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+	if(!unix_path.empty()) {
+		unlink(unix_path.c_str());
+		unix_path.clear();
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_NET_TRANSPORT_H
+#define PICOLAN_NET_TRANSPORT_H
+
+#ifdef __unix__
+
+#include <string>
+#include "fd_transport.h"
+
+namespace picolan
+{
+
+	/**
+	 * UdpTransport carries PicoLAN frames between two hosts in UDP datagrams, one frame per
+	 * datagram. Datagrams already have boundaries and checksums, so frames are sent without
+	 * start, end or escape bytes. Lost datagrams are recovered like frames lost to line noise.
+	 *
+	 * \code
+	 * UdpTransport udp;
+	 * udp.open(7000, "127.0.0.1", 7001);
+	 * Interface iface(udp);
+	 * \endcode
+	 */
+	class UdpTransport : public FdTransport
+	{
+		public:
+			/**
+			 * \brief binds a local port and sends to the remote host and port.
+			 * Datagrams from anywhere else are ignored.
+			 * @param local_port the port to receive on, or zero for any
+			 * @param host the remote host name or address, IPv4 or IPv6
+			 * @param port the remote port
+			 * \return Error::NONE or Error::IO
+			 */
+			int open(uint16_t local_port, const std::string& host, uint16_t port);
+	};
+
+	/**
+	 * TcpTransport carries PicoLAN over a TCP connection as a byte stream, framed just like a
+	 * serial port. Nagle's algorithm is disabled so each flush goes out at once.
+	 * Use a TransportListener to accept connections.
+	 */
+	class TcpTransport : public FdTransport
+	{
+		public:
+			/**
+			 * \brief connects to a listening host.
+			 * \return Error::NONE or Error::IO
+			 */
+			int connect(const std::string& host, uint16_t port);
+	};
+
+	/**
+	 * UnixTransport connects to another process on the same host through a Unix domain socket.
+	 * By default it is a byte stream framed like a serial port. When framed is true it uses
+	 * SOCK_SEQPACKET and sends one frame per message without framing bytes, like UdpTransport.
+	 * Both ends must agree. Use a TransportListener to accept connections.
+	 */
+	class UnixTransport : public FdTransport
+	{
+		public:
+			/**
+			 * \brief connects to a listening socket.
+			 * @param path the socket path
+			 * @param framed true for one frame per message
+			 * \return Error::NONE or Error::IO
+			 */
+			int connect(const std::string& path, bool framed = false);
+	};
+
+	/**
+	 * TransportListener accepts TCP or Unix domain socket connections and hands each one to a
+	 * transport. Wait on get_fd() with poll() to accept without blocking.
+	 */
+	class TransportListener
+	{
+		public:
+			TransportListener() { }
+			~TransportListener();
+
+			TransportListener(const TransportListener&) = delete;
+			TransportListener& operator=(const TransportListener&) = delete;
+
+			/**
+			 * \brief listens for TCP connections.
+			 * @param port the port to listen on
+			 * @param host the address to listen on. Empty for every address.
+			 * \return Error::NONE or Error::IO
+			 */
+			int listen_tcp(uint16_t port, const std::string& host = "");
+
+			/**
+			 * \brief listens on a Unix domain socket. Any existing file at the path is replaced,
+			 * and the file is removed when the listener is closed.
+			 * @param framed true for one frame per message. Clients must match.
+			 * \return Error::NONE or Error::IO
+			 */
+			int listen_unix(const std::string& path, bool framed = false);
+
+			/**
+			 * \brief waits for a connection and attaches it to a transport.
+			 * @param transport the transport for the new connection. Anything it had open is closed.
+			 * @param timeout_ms how long to wait. Zero returns at once.
+			 * \return Error::NONE, Error::TIMEOUT or Error::IO
+			 */
+			int accept(FdTransport& transport, uint32_t timeout_ms);
+
+			void close();
+
+			int get_fd() const {
+				return fd;
+			}
+
+		private:
+			int fd = -1;
+			bool framed = false;
+			bool tcp = false;
+			std::string unix_path;
+	};
+
+}
+
+#endif
+
+#endif
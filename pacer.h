@@ -0,0 +1,208 @@
+#ifndef PICOLAN_PACER_H
+#define PICOLAN_PACER_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "ulan_time.h"
+#include "serialiser.h"
+
+namespace picolan
+{
+
+/**
+ * TokenBucket limits a byte rate while allowing bursts up to the bucket depth.
+ * Tokens are kept in thousandths of a byte so that slow rates still refill
+ * between millisecond ticks. A frame may be sent whenever the bucket isn't in debt,
+ * and its cost is then taken even if that leaves the bucket negative. This lets frames
+ * larger than the bucket through while still holding the long term rate.
+ */
+class TokenBucket
+{
+public:
+	/**
+	 * \brief sets the rate and depth. The bucket starts full.
+	 * @param bytes_per_sec the long term rate. Zero disables the bucket.
+	 * @param depth the largest burst in bytes
+	 */
+	void configure(uint32_t bytes_per_sec, uint16_t depth) {
+		rate = bytes_per_sec;
+		max_tokens = (int32_t)depth * 1000;
+		tokens = max_tokens;
+		last = now_ms();
+	}
+
+	bool enabled() const {
+		return rate != 0;
+	}
+
+	/**
+	 * \brief returns true if a frame may be sent now.
+	 */
+	bool ready() {
+		if(rate == 0) {
+			return true;
+		}
+		refill();
+		return tokens >= 0;
+	}
+
+	/**
+	 * \brief takes the cost of a frame that has been sent.
+	 */
+	void consume(uint32_t bytes) {
+		if(rate != 0) {
+			tokens -= (int32_t)bytes * 1000;
+		}
+	}
+
+private:
+	void refill() {
+		uint32_t now = now_ms();
+		uint32_t dt = now - last;
+		if(dt == 0) {
+			return;
+		}
+		last = now;
+
+		// a full bucket refills in under a second at any useful rate. fast links (UDP,
+		// shared memory) pass 2 MB/s, where a second's worth of tokens doesn't fit in
+		// 32 bits, so the sum is clamped in 64 bits before it is stored
+		if(dt > 1000) {
+			dt = 1000;
+		}
+		int64_t t = (int64_t)tokens + (int64_t)dt * rate;
+		tokens = (t > max_tokens) ? max_tokens : (int32_t)t;
+	}
+
+	uint32_t rate = 0;
+	int32_t max_tokens = 0;
+	int32_t tokens = 0;
+	uint32_t last = 0;
+};
+
+
+/**
+ * Pacer decides when an outgoing frame may be written so that bursts are smoothed to
+ * what the link and the next hop can absorb. Every frame passes through the link bucket,
+ * and frames to a destination with its own bucket must pass that too.
+ */
+class Pacer
+{
+public:
+	static constexpr uint8_t MAX_DESTINATIONS = Config::PACED_DESTINATIONS;
+
+	/**
+	 * \brief paces the link. Each byte takes ten bit times on the wire (8N1).
+	 * @param baud the link baud rate. Zero disables link pacing.
+	 * @param depth the receive buffer of the next hop in bytes
+	 */
+	void set_link(uint32_t baud, uint16_t depth) {
+		link.configure(baud/10, depth);
+	}
+
+	/**
+	 * \brief paces frames sent to one destination address.
+	 * \return false if there are already MAX_DESTINATIONS paced destinations.
+	 */
+	bool set_dest(uint8_t addr, uint32_t bytes_per_sec, uint16_t depth) {
+		for(auto& d : dests) {
+			if(d.addr == addr) {
+				d.bucket.configure(bytes_per_sec, depth);
+				return true;
+			}
+		}
+		if(bytes_per_sec == 0) {
+			return true;
+		}
+		if(dests.size() >= MAX_DESTINATIONS) {
+			return false;
+		}
+		Dest d;
+		d.addr = addr;
+		d.bucket.configure(bytes_per_sec, depth);
+		dests.append(d);
+		return true;
+	}
+
+	bool enabled() const {
+		return link.enabled() || (dests.size() != 0);
+	}
+
+	/**
+	 * \brief returns true if the frame may be written now.
+	 * @param frame an unstuffed frame as passed to ParserSerialiser::emit_frame()
+	 */
+	bool ready(const uint8_t* frame, uint8_t len) {
+		if(!link.ready()) {
+			return false;
+		}
+		TokenBucket* b = dest_bucket(frame, len);
+		return (b == nullptr) || b->ready();
+	}
+
+	/**
+	 * \brief charges the buckets for a frame that has been written.
+	 */
+	void sent(const uint8_t* frame, uint8_t len) {
+		uint32_t cost = wire_length(frame, len);
+		link.consume(cost);
+		TokenBucket* b = dest_bucket(frame, len);
+		if(b != nullptr) {
+			b->consume(cost);
+		}
+	}
+
+	/**
+	 * \brief the number of bytes a frame takes on the wire, including the start and end
+	 * bytes and any escape bytes.
+	 */
+	static uint32_t wire_length(const uint8_t* frame, uint8_t len) {
+		uint32_t n = len + 2;
+		for(uint8_t i = 0; i < len; i++) {
+			if((frame[i] >= 0xAA) && (frame[i] <= 0xAC)) {
+				n++;
+			}
+		}
+		return n;
+	}
+
+private:
+	struct Dest
+	{
+		uint8_t addr;
+		TokenBucket bucket;
+	};
+
+	TokenBucket* dest_bucket(const uint8_t* frame, uint8_t len) {
+		if(dests.size() == 0) {
+			return nullptr;
+		}
+
+		// pings, echoes and datagrams all carry ttl, source and destination
+		// straight after the id and size bytes
+		if(len < 5) {
+			return nullptr;
+		}
+		uint8_t id = frame[0];
+		if((id != PING_PACK) && (id != PING_ECHO_PACK) && (id != DATAGRAM_PACK)) {
+			return nullptr;
+		}
+		for(auto& d : dests) {
+			if(d.addr == frame[4]) {
+				return &d.bucket;
+			}
+		}
+		return nullptr;
+	}
+
+	TokenBucket link;
+	etk::List<Dest, MAX_DESTINATIONS> dests;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "pcap.h"
+
+#ifndef ARDUINO
+
+#include <chrono>
+
+namespace picolan
+{
+
+constexpr uint16_t PcapWriter::LINKTYPE_USER0;
+
+namespace
+{
+
+// pcapng block types and options
+constexpr uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+constexpr uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+constexpr uint32_t ENHANCED_PACKET_BLOCK = 6;
+constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+constexpr uint16_t OPT_ENDOFOPT = 0;
+constexpr uint16_t OPT_EPB_FLAGS = 2;
+constexpr uint32_t EPB_INBOUND = 1;
+constexpr uint32_t EPB_OUTBOUND = 2;
+
+}
+
+PcapWriter::~PcapWriter()
+{
+	close();
+}
+
+bool PcapWriter::open(const std::string& path)
+{
+	close();
+	file = fopen(path.c_str(), "wb");
+	if(file == nullptr) {
+		return false;
+	}
+
+	using namespace std::chrono;
+	int64_t wall = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+	epoch_offset_us = wall - (int64_t)now_us();
+
+	// the section length is unknown, which pcapng marks as -1
+	const uint32_t shb_len = 28;
+	bool ok = put32(SECTION_HEADER_BLOCK) && put32(shb_len) && put32(BYTE_ORDER_MAGIC)
+		&& put16(1) && put16(0) && put32(0xFFFFFFFF) && put32(0xFFFFFFFF) && put32(shb_len);
+
+	// the default timestamp resolution is microseconds, so no options are needed
+	const uint32_t idb_len = 20;
+	ok = ok && put32(INTERFACE_DESCRIPTION_BLOCK) && put32(idb_len)
+		&& put16(LINKTYPE_USER0) && put16(0) && put32(CAPTURE_FRAME_LENGTH) && put32(idb_len);
+
+	if(!ok || (fflush(file) != 0)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+uint32_t PcapWriter::write(CaptureRing& ring)
+{
+	if(file == nullptr) {
+		return 0;
+	}
+
+	uint32_t n = 0;
+	const CaptureRecord* r;
+	while((r = ring.peek()) != nullptr) {
+		uint32_t padded = (r->len + 3u) & ~3u;
+		uint32_t block_len = 28 + padded + 12 + 4;
+		uint64_t ts = (uint64_t)((int64_t)r->time_us + epoch_offset_us);
+		const uint8_t zeros[3] = {0, 0, 0};
+
+		bool ok = put32(ENHANCED_PACKET_BLOCK) && put32(block_len) && put32(0)
+			&& put32(ts >> 32) && put32(ts & 0xFFFFFFFF) && put32(r->len) && put32(r->len)
+			&& put(r->frame, r->len) && put(zeros, padded - r->len)
+			&& put16(OPT_EPB_FLAGS) && put16(4)
+			&& put32((r->direction == CAPTURE_TX) ? EPB_OUTBOUND : EPB_INBOUND)
+			&& put16(OPT_ENDOFOPT) && put16(0) && put32(block_len);
+		ring.pop();
+		if(!ok) {
+			break;
+		}
+		n++;
+	}
+	fflush(file);
+	return n;
+}
+
+void PcapWriter::close()
+{
+	if(file != nullptr) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+bool PcapWriter::put16(uint16_t v)
+{
+	return put(&v, 2);
+}
+
+bool PcapWriter::put32(uint32_t v)
+{
+	return put(&v, 4);
+}
+
+bool PcapWriter::put(const void* data, uint32_t len)
+{
+	return fwrite(data, 1, len, file) == len;
+}
+
+}
+
+#endif
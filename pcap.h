@@ -0,0 +1,100 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_PCAP_H
+#define PICOLAN_PCAP_H
+
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <string>
+#include "capture.h"
+
+namespace picolan
+{
+
+	/**
+	 * PcapWriter saves frames from a CaptureRing to a pcapng file that Wireshark and tcpdump can read.
+	 * Frames use the LINKTYPE_USER0 link type (147) and are written without start, end or escape bytes.
+	 * Each one is marked inbound or outbound and timestamped to the microsecond.
+	 * write() is the consumer side of the ring, so it may be called from a thread of its own
+	 * while the interface is serviced on another. This is only available on hosts.
+	 *
+	 * \code
+	 * static CaptureRecord records[1024];
+	 * CaptureRing ring(records, 1024);
+	 * PcapWriter pcap;
+	 * pcap.open("picolan.pcapng");
+	 * iface.set_capture(&ring);
+	 * ...
+	 * pcap.write(ring);
+	 * \endcode
+	 */
+	class PcapWriter
+	{
+		public:
+			static constexpr uint16_t LINKTYPE_USER0 = 147;
+
+			PcapWriter() { }
+			~PcapWriter();
+
+			PcapWriter(const PcapWriter&) = delete;
+			PcapWriter& operator=(const PcapWriter&) = delete;
+
+			/**
+			 * \brief creates the file and writes the section and interface headers.
+			 * \return false if the file couldn't be created
+			 */
+			bool open(const std::string& path);
+
+			bool is_open() const {
+				return file != nullptr;
+			}
+
+			/**
+			 * \brief moves every frame in the ring to the file.
+			 * \return the number of frames written
+			 */
+			uint32_t write(CaptureRing& ring);
+
+			void close();
+
+		private:
+			bool put16(uint16_t v);
+			bool put32(uint32_t v);
+			bool put(const void* data, uint32_t len);
+
+			FILE* file = nullptr;
+			// converts the monotonic library clock to wall clock time
+			int64_t epoch_offset_us = 0;
+	};
+
+}
+
+#endif
+
+#endif
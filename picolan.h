@@ -59,12 +59,22 @@
 #include "datagram.h"
 #include "server.h"
 #include "client.h"
+#include "connection.h"
+#include "connection_table.h"
+#include "tx_queue.h"
+#include "pacer.h"
+#include "timer_wheel.h"
+#include "ping_engine.h"
+#include "topology.h"
 #include "ulan_time.h"
 
 #ifdef ARDUINO
 #include <Arduino.h>
-#else
+#elif defined(PICOLAN_NODE_BINDING)
 #include "usart_driver.h"
+#else
+#include <string.h>
+#include "transport.h"
 #endif
 
 namespace picolan
@@ -79,6 +89,8 @@ class Interface
 		/**
 		 * \brief The constructor requires a reference to a Stream object so
 		 * that it can handle reading and writing over the UART / interface.
+		 * On a host it takes a Transport, such as LinuxSerial. A byte at a time
+		 * serial driver can be wrapped in a StreamTransport.
 		 */
 		#ifdef PICOLAN_NODE_BINDING
 		Interface(std::string com_port) : serial(com_port) {
@@ -88,7 +100,7 @@ class Interface
 		#elif ARDUINO
 		Interface(Stream& serial) : serial(serial) { }
         #else
-        Interface(Serial& serial) : serial(serial) { }
+        Interface(Transport& transport) : serial(transport) { }
 		#endif
 
 		/**
@@ -103,6 +115,7 @@ class Interface
 			address = addr;
 			pack.address_field.set_addr(addr);
 			pack.send();
+			flush();
 		}
 
 		/**
@@ -130,8 +143,8 @@ class Interface
             addr_list_recved = false;
 			pack.send();
 
-			auto start = millis();
-			while((millis()-start) < timeout_ms) {
+			auto start = now_ms();
+			while((now_ms()-start) < timeout_ms) {
 				read();
 				if(addr_list_recved) {
 					return Error::NONE;
@@ -140,9 +153,50 @@ class Interface
 			return Error::TIMEOUT;
 		}
 
+		/**
+		 * \brief returns true if the address was in the last list received from the switch.
+		 * This answers from the topology cache and doesn't send anything.
+		 */
 		bool lookup_addr_list(uint8_t addr)
 		{
-			return addr_field.get_addr(addr);
+			return topology.present(addr);
+		}
+
+		/**
+		 * \brief asks the switch for the address list without waiting for it.
+		 * The topology cache is updated when the list arrives.
+		 */
+		void request_addr_list()
+		{
+			auto pack = create_packet<get_addr_list_pack>();
+			pack.ttl = 6;
+			pack.send();
+			flush();
+		}
+
+		/**
+		 * \brief refreshes the topology cache in the background by requesting the address
+		 * list every interval_ms milliseconds while the interface is serviced.
+		 * @param interval_ms the refresh interval. Zero stops refreshing.
+		 */
+		void set_addr_refresh(uint32_t interval_ms)
+		{
+			addr_refresh_ms = interval_ms;
+			if(interval_ms == 0) {
+				addr_refresh_timer.cancel();
+				return;
+			}
+			request_addr_list();
+			timers.schedule(addr_refresh_timer, interval_ms);
+		}
+
+		/**
+		 * \brief returns the cache of addresses present on the network.
+		 * Use TopologyCache::set_change_callback() to hear about devices joining and leaving.
+		 */
+		TopologyCache& get_topology()
+		{
+			return topology;
 		}
 
 		/**
@@ -169,10 +223,174 @@ class Interface
 		void unbind_socket(Socket& s)
 		{
 			for(uint32_t i = 0; i < sockets.size(); i++) {
-				if(sockets[i]->get_port() == s.get_port()) {
+				if(sockets[i] == &s) {
 					sockets.remove(i);
 				}
 			}
+			connections.remove(&s);
+			unwake(s);
+		}
+
+		/**
+		 * \brief the most sockets get_socket_stats() can report, bound sockets plus connections.
+		 */
+		static constexpr uint32_t MAX_SOCKET_STATS = Config::MAX_SOCKETS + ConnectionTable::SIZE;
+
+		/**
+		 * \brief returns a snapshot of the frame and byte counters for the link.
+		 * Checksum errors and resyncs point to line noise, a growing transmit backlog to
+		 * congestion, and receive overflows on a socket to a slow consumer.
+		 */
+		LinkStats get_link_stats() const
+		{
+			return get_link_counters().snapshot();
+		}
+
+		/**
+		 * \brief takes a snapshot of the counters of every bound socket and accepted connection.
+		 * @param out where the snapshots are stored
+		 * @param max the number of snapshots out can hold
+		 * \return the number of sockets, which may be more than max
+		 */
+		uint32_t get_socket_stats(SocketStats* out, uint32_t max)
+		{
+			uint32_t n = 0;
+			for(auto& s : sockets) {
+				if(n < max) {
+					out[n] = s->get_stats();
+				}
+				n++;
+			}
+			for(uint32_t i = 0; i < ConnectionTable::SIZE; i++) {
+				Socket* s = connections.slot(i);
+				if(s == nullptr) {
+					continue;
+				}
+				if(n < max) {
+					out[n] = s->get_stats();
+				}
+				n++;
+			}
+			return n;
+		}
+
+		/**
+		 * \brief returns a bound socket or accepted connection, in the same order as get_socket_stats().
+		 * \return the socket, or nullptr if i is past the last one
+		 */
+		Socket* get_socket(uint32_t i)
+		{
+			if(i < sockets.size()) {
+				return sockets[i];
+			}
+			i -= sockets.size();
+			for(uint32_t j = 0; j < ConnectionTable::SIZE; j++) {
+				Socket* s = connections.slot(j);
+				if(s == nullptr) {
+					continue;
+				}
+				if(i == 0) {
+					return s;
+				}
+				i--;
+			}
+			return nullptr;
+		}
+
+		/**
+		 * \brief sets the link counters and the counters of every socket back to zero.
+		 * Latency histograms are cleared too when PICOLAN_LATENCY_STATS is defined.
+		 */
+		void reset_stats()
+		{
+			reset_link_counters();
+			#ifdef PICOLAN_LATENCY_STATS
+			get_latency().reset();
+			#endif
+			Socket* s;
+			for(uint32_t i = 0; (s = get_socket(i)) != nullptr; i++) {
+				s->reset_stats();
+				#ifdef PICOLAN_LATENCY_STATS
+				s->reset_latency();
+				#endif
+			}
+		}
+
+		/**
+		 * \brief registers an accepted connection so that frames from its remote
+		 * address to its local port are delivered straight to it. Used by Server::accept().
+		 * @param s the connection
+		 * @param remote_port the port of the client, from its SYN
+		 * \return false if the connection table is full or the connection already exists.
+		 */
+		bool register_connection(Socket& s, uint8_t remote_port)
+		{
+			s.iface = this;
+			return connections.insert(s.remote, s.port, remote_port, &s);
+		}
+
+		/**
+		 * \brief picks the local port for a new connection from a remote to a server.
+		 * This is the server's own port unless that remote already has a connection on it,
+		 * in which case it is the highest port that is neither bound nor used by another
+		 * connection from the remote. The server names the port in its SYN and the client
+		 * sends to it from then on, so two clients on one node can use the same server.
+		 * \return the port, or zero if every port is taken.
+		 */
+		uint8_t connection_port(uint8_t remote, uint8_t port)
+		{
+			if(connections.find(remote, port) == nullptr) {
+				return port;
+			}
+			for(uint8_t p = 255; p != 0; p--) {
+				if(connections.find(remote, p) != nullptr) {
+					continue;
+				}
+				bool bound = false;
+				for(auto& s : sockets) {
+					if(s->get_port() == p) {
+						bound = true;
+						break;
+					}
+				}
+				if(!bound) {
+					return p;
+				}
+			}
+			return 0;
+		}
+
+		/**
+		 * \brief removes a connection from the connection table.
+		 */
+		void unregister_connection(Socket& s)
+		{
+			connections.remove(&s);
+			unwake(s);
+		}
+
+		/**
+		 * \brief asks for the socket's on_ready() to be called from service() once the frames
+		 * that have arrived are parsed. Streams use this to send when an ACK opens the window,
+		 * rather than sending from inside the handler of the frame that carried it.
+		 */
+		void wake(Socket& s)
+		{
+			if(s.ready_queued) {
+				return;
+			}
+			s.ready_queued = true;
+			s.ready_next = ready;
+			ready = &s;
+		}
+
+		/**
+		 * \brief looks up the connection from a client, by its address and port.
+		 * \return the connection, or nullptr if there isn't one.
+		 */
+		Socket* find_connection(uint8_t remote, uint8_t remote_port)
+		{
+			return connections.find_remote(remote, remote_port);
 		}
 
 		bool bind_datagram(Datagram& dg) {
@@ -204,34 +422,136 @@ class Interface
 		 * This can be useful for troubleshooting.
 		 * @param dest the destination address
 		 * @param timeout_ms timeout in milliseconds
-		 * \return either the ping time or ERROR_TIMEOUT
+		 * \return either the ping time in milliseconds or ERROR_TIMEOUT
 		 */
 
 		int ping(uint8_t dest, uint32_t timeout_ms = 1000)
+		{
+			int32_t us = ping_us(dest, timeout_ms);
+			if(us < 0) {
+				return us;
+			}
+			return us/1000;
+		}
+
+		/**
+		 * \brief Sends a ping to the destination and times the response in microseconds.
+		 * Each ping carries a sequence number, so a late echo of an earlier ping isn't mistaken for this one.
+		 * @param dest the destination address
+		 * @param timeout_ms timeout in milliseconds
+		 * \return either the ping time in microseconds or ERROR_TIMEOUT
+		 */
+		int32_t ping_us(uint8_t dest, uint32_t timeout_ms = 1000)
 		{
 			auto pack = create_packet<ping_pack>();
 			pack.ttl = 6;
 			pack.dest_addr = dest;
 			pack.source_addr = address;
-			uint16 payload = millis();
-			pack.payload = payload;
+			// the top bit is left clear, sequence numbers with it set belong to the PingEngine
+			ping_seq = (ping_seq+1) & 0x7FFF;
+			pack.payload = ping_seq;
+			ping_echo_recved = false;
+
+			uint64_t start = now_us();
 			pack.send();
 
-			auto start = millis();
-			while((millis()-start) < timeout_ms) {
+			while((now_us()-start) < ((uint64_t)timeout_ms*1000)) {
 				read();
-				if(ping_echo_payload == payload) {
-					return millis()-start;
+				if(ping_echo_recved) {
+					return (int32_t)(ping_echo_time - start);
 				}
 			}
 			return Error::TIMEOUT;
 		}
 
 		/**
-		 * \brief flushes the network interface stream
+		 * \brief gives the interface a transmit queue, so that outgoing frames are sent by priority
+		 * rather than in the order they were created. Control frames (stream SYN and ACK, pings and
+		 * address packets) go first, then datagrams, then stream data. A stream's CLOSE is queued
+		 * behind its data. See Socket::set_priority().
+		 * Queued frames are sent each time the interface is serviced or flushed.
+		 * Without a queue every frame is written as soon as it is created.
+		 * @param buffer storage for queued frames. It is divided equally between the three priority classes,
+		 * and each class needs at least MAX_FRAME_LENGTH+1 bytes. Pass nullptr to remove the queue.
+		 * @param len the length of the buffer
+		 * \return false if the buffer is too small. The interface is left without a queue.
+		 */
+		#ifndef PICOLAN_NODE_BINDING
+		bool set_tx_queue(uint8_t* buffer, uint32_t len)
+		{
+			flush();
+			return txq.set_buffer(buffer, len);
+		}
+		#else
+		bool set_tx_queue(uint32_t len)
+		{
+			flush();
+			txq_buf.resize(len);
+			return txq.set_buffer(txq_buf.data(), len);
+		}
+		#endif
+
+		/**
+		 * \brief sets how the transmit queue chooses between priority classes.
+		 * TxQueue::STRICT (the default) always sends the highest priority frame waiting, so bulk data
+		 * only moves when nothing else is queued. TxQueue::WEIGHTED lets each class send a number
+		 * of frames in turn, set by set_tx_weights(), so bulk data can't be starved.
+		 */
+		void set_tx_policy(uint8_t policy)
+		{
+			txq.set_policy(policy);
+		}
+
+		/**
+		 * \brief sets the frames sent per turn by each priority class in TxQueue::WEIGHTED mode.
+		 * The defaults are 4, 2 and 1.
+		 */
+		void set_tx_weights(uint8_t control, uint8_t datagram, uint8_t bulk)
+		{
+			txq.set_weights(control, datagram, bulk);
+		}
+
+		/**
+		 * \brief paces transmissions so that bursts don't overrun the next hop.
+		 * Frames are let through at the link rate, with bursts limited to the receive buffer
+		 * of the switch (or whatever the interface is connected to). With a transmit queue
+		 * (see set_tx_queue()) frames wait in the queue until service() finds they may be sent.
+		 * Otherwise sending a frame blocks until it may be written, servicing the interface meanwhile.
+		 * @param baud the link baud rate, or zero to disable link pacing
+		 * @param buffer_bytes the receive buffer of the next hop in bytes
+		 */
+		void set_pacing(uint32_t baud, uint16_t buffer_bytes)
+		{
+			pacer.set_link(baud, buffer_bytes);
+		}
+
+		/**
+		 * \brief paces frames to one destination, for a device that is slower than the link.
+		 * This applies to datagrams, streams and pings sent to the address.
+		 * @param dest the destination address
+		 * @param bytes_per_sec the rate the destination can absorb, or zero to stop pacing it
+		 * @param buffer_bytes the largest burst the destination can absorb
+		 * \return false if too many destinations are already paced. See Pacer::MAX_DESTINATIONS.
+		 */
+		bool set_dest_pacing(uint8_t dest, uint32_t bytes_per_sec, uint16_t buffer_bytes)
+		{
+			return pacer.set_dest(dest, bytes_per_sec, buffer_bytes);
+		}
+
+		/**
+		 * \brief sends all queued frames and flushes the network interface stream.
+		 * When pacing is enabled this waits until the queue is empty, servicing the interface
+		 * while it waits.
 		 */
 		void flush() {
-			serial.flush();
+			send_queued();
+			uint8 frame[MAX_FRAME_LENGTH];
+			uint8 len;
+			while((len = txq.peek(frame)) != 0) {
+				wait_for_pacer(frame, len);
+				send_queued();
+			}
+			flush_stream();
 		}
 
 		/**
@@ -242,15 +562,191 @@ class Interface
 			return serial.available() != 0;
 		}
 
-		void read() {
-			while(available()) {
+		/**
+		 * \brief returns the timer wheel that tracks protocol deadlines such as retransmits
+		 * and keepalives. Applications may schedule their own timers on it too.
+		 * Timers expire when the interface is serviced.
+		 */
+		TimerWheel& get_timers() {
+			return timers;
+		}
+
+		/**
+		 * \brief services the interface. All available bytes are read and parsed, then
+		 * expired timers are run, which is when streams retransmit unacknowledged frames and
+		 * send frames held back for coalescing. Finally any frames in the transmit queue are sent.
+		 * This should be called regularly by applications that use non-blocking sockets.
+		 * The cost doesn't depend on the number of sockets that are idle.
+		 */
+		void service() {
+			// only the bytes already waiting are read, so a busy link can't hold
+			// back timers and queued frames indefinitely
+			uint32_t n = serial.available();
+			bool was_parsing = parsing;
+			parsing = true;
+			#if defined(ARDUINO) || defined(PICOLAN_NODE_BINDING)
+			while(n--) {
 				ParserSerialiser::read(get());
 			}
+			#else
+			if(serial.is_framed()) {
+				// one frame per read, so this is bounded by frames rather than bytes
+				for(uint32_t i = 0; (n != 0) && (i < FRAMES_PER_SERVICE); i++) {
+					int r = serial.read(rx_block, sizeof(rx_block));
+					if(r <= 0) {
+						break;
+					}
+					read_frame(rx_block, r);
+				}
+				n = 0;
+			}
+			while(n != 0) {
+				int r = serial.read(rx_block, (n < sizeof(rx_block)) ? n : sizeof(rx_block));
+				if(r <= 0) {
+					break;
+				}
+				ParserSerialiser::read(rx_block, r);
+				n -= ((uint32_t)r < n) ? r : n;
+			}
+			#endif
+			parsing = was_parsing;
+			// a socket waiting for the pacer is part way through sending, so it isn't re-entered
+			if(!pacer_wait) {
+				run_ready();
+			}
+			timers.advance();
+			send_queued();
+		}
+
+		/**
+		 * \brief reads and parses all available bytes. Equivalent to service().
+		 */
+		void read() {
+			service();
+		}
+
+		#if !defined(ARDUINO) && !defined(PICOLAN_NODE_BINDING)
+		/**
+		 * \brief parses bytes that were received outside service(), such as by an I/O loop that
+		 * reads many transports at once. A framed transport must pass exactly one frame.
+		 * Streams that an ACK lets send again do so on the next call to service().
+		 */
+		void receive(const uint8_t* data, uint32_t len) {
+			bool was_parsing = parsing;
+			parsing = true;
+			if(serial.is_framed()) {
+				read_frame(data, len);
+			} else {
+				ParserSerialiser::read(data, len);
+			}
+			parsing = was_parsing;
+		}
+		#endif
+
+	protected:
+		void emit_frame(const uint8* frame, uint8 len, uint8 priority)
+		{
+			if(!txq.enabled()) {
+				write_paced(frame, len);
+				flush_stream();
+				return;
+			}
+
+			// frames wait in the queue until the pacer lets them go, which service() checks.
+			// When the class is full the caller is held back rather than the frame being dropped.
+			while(!txq.push(priority, frame, len)) {
+				uint8 next[MAX_FRAME_LENGTH];
+				uint8 n = txq.peek(next);
+				wait_for_pacer(next, n);
+				send_queued();
+			}
 		}
 
 	private:
 		friend class ParserSerialiser;
+		friend class PingEngine;
+
+		void set_ping_engine(PingEngine* e) {
+			ping_engine = e;
+		}
+
+		static void on_addr_refresh(void* i) {
+			Interface* iface = (Interface*)i;
+			iface->request_addr_list();
+			iface->timers.schedule(iface->addr_refresh_timer, iface->addr_refresh_ms);
+		}
+
+		// sends queued frames until the queue is empty or the pacer holds the next one back
+		void send_queued()
+		{
+			uint8 frame[MAX_FRAME_LENGTH];
+			uint8 len;
+			bool sent = false;
+			while((len = txq.peek(frame)) != 0) {
+				if(!pacer.ready(frame, len)) {
+					break;
+				}
+				txq.pop(frame);
+				send_frame(frame, len);
+				pacer.sent(frame, len);
+				sent = true;
+			}
+			if(sent) {
+				flush_stream();
+			}
+		}
 
+		// writes a frame, waiting first if the pacer is holding frames back
+		void write_paced(const uint8* frame, uint8 len)
+		{
+			wait_for_pacer(frame, len);
+			send_frame(frame, len);
+			pacer.sent(frame, len);
+		}
+
+		void run_ready()
+		{
+			while(ready != nullptr) {
+				Socket* s = ready;
+				ready = s->ready_next;
+				s->ready_next = nullptr;
+				s->ready_queued = false;
+				s->on_ready();
+			}
+		}
+
+		void unwake(Socket& s)
+		{
+			for(Socket** p = &ready; *p != nullptr; p = &(*p)->ready_next) {
+				if(*p == &s) {
+					*p = s.ready_next;
+					s.ready_next = nullptr;
+					s.ready_queued = false;
+					return;
+				}
+			}
+		}
+
+		// The interface is serviced while it waits, so input is still read and a simulated link
+		// can move the clock on. A wait that starts while input is being parsed, or inside
+		// another wait, only polls the link, because parsing again would overwrite the frame
+		// being handled.
+		void wait_for_pacer(const uint8* frame, uint8 len)
+		{
+			bool was_waiting = pacer_wait;
+			bool nested = parsing || was_waiting;
+			pacer_wait = true;
+			while(!pacer.ready(frame, len)) {
+				if(nested) {
+					serial.available();
+				} else {
+					service();
+				}
+			}
+			pacer_wait = was_waiting;
+		}
+
+		#if defined(ARDUINO) || defined(PICOLAN_NODE_BINDING)
 		uint8 get() {
 			uint8 r = serial.get();
 			return r;
@@ -264,6 +760,68 @@ class Interface
 			#endif
 		}
 
+		#ifdef ARDUINO
+		void put_block(const uint8* data, uint32 len) {
+			serial.write(data, len);
+		}
+		#endif
+
+		void flush_stream() {
+			serial.flush();
+		}
+
+		void send_frame(const uint8* frame, uint8 len) {
+			write_frame(frame, len);
+		}
+		#else
+		static constexpr uint32_t FRAMES_PER_SERVICE = 64;
+
+		void send_frame(const uint8* frame, uint8 len) {
+			if(serial.is_framed()) {
+				serial.write(frame, len);
+				frame_written(frame, len, len, 0);
+				return;
+			}
+			write_frame(frame, len);
+		}
+
+		// bytes are gathered into blocks so the transport sees one write per flush
+		void put(uint8 c) {
+			if(tx_block_len == sizeof(tx_block)) {
+				write_block();
+			}
+			tx_block[tx_block_len++] = c;
+		}
+
+		void put_block(const uint8* data, uint32 len) {
+			while(len != 0) {
+				if(tx_block_len == sizeof(tx_block)) {
+					write_block();
+				}
+				uint32 n = sizeof(tx_block) - tx_block_len;
+				if(n > len) {
+					n = len;
+				}
+				memcpy(&tx_block[tx_block_len], data, n);
+				tx_block_len += n;
+				data += n;
+				len -= n;
+			}
+		}
+
+		void write_block() {
+			if(tx_block_len != 0) {
+				serial.write(tx_block, tx_block_len);
+				tx_block_len = 0;
+			}
+		}
+
+		void flush_stream() {
+			write_block();
+			serial.flush();
+		}
+		#endif
+
 		void get_addr_list_pack_handler(get_addr_list_pack& pack)
 		{
 			auto res = create_packet<addr_pack>();
@@ -273,7 +831,8 @@ class Interface
 
 		void addr_pack_handler(addr_pack& pack)
 		{
-			addr_field = pack.address_field;
+			// every list from the switch is complete, so it replaces the cached one
+			topology.update(pack.address_field);
 			addr_list_recved = true;
 		}
 
@@ -289,7 +848,16 @@ class Interface
 
 		void ping_echo_pack_handler(ping_echo_pack& ping_echo)
 		{
-			ping_echo_payload = ping_echo.payload;
+			if(ping_echo.payload & 0x8000) {
+				if(ping_engine != nullptr) {
+					ping_engine->on_echo(ping_echo.source_addr, ping_echo.payload);
+				}
+				return;
+			}
+			if(ping_echo.payload == ping_seq) {
+				ping_echo_time = now_us();
+				ping_echo_recved = true;
+			}
 		}
 
 		void datagram_pack_handler(datagram_pack& pack)
@@ -297,9 +865,23 @@ class Interface
 			if((pack.dest_addr == address)
 					|| (pack.dest_addr == BROADCAST_ADDR)
                     || (pack.dest_addr == MULTICAST_ADDR)) {
+				// accepted connections are found by remote address and port.
+				// SYNs always go to the listening server.
+				if((pack.payload.size() != 0) && (pack.payload[0] != MESSAGE_TYPE::SYN)) {
+					Socket* c = connections.find(pack.source_addr, pack.port);
+					if(c != nullptr) {
+						c->counters.rx_frames.add();
+						c->on_data(
+								pack.source_addr,
+								pack.payload.buffer(),
+								pack.payload.size());
+						return;
+					}
+				}
 				for(auto& l : sockets) {
 					if(l->port == pack.port) {
 						l->remote = pack.source_addr;
+						l->counters.rx_frames.add();
 						l->on_data(
 								pack.source_addr,
 								pack.payload.buffer(),
@@ -319,17 +901,40 @@ class Interface
 #elif ARDUINO
 		Stream& serial;
 #else
-        Serial& serial;
+		Transport& serial;
+		uint8_t rx_block[Config::RX_BLOCK];
+		uint8_t tx_block[Config::TX_BLOCK];
+		uint32_t tx_block_len = 0;
 #endif
 		uint8_t address;
-		uint16_t ping_echo_payload = 0;
+		uint16_t ping_seq = 0;
+		bool ping_echo_recved = false;
+		uint64_t ping_echo_time = 0;
+		PingEngine* ping_engine = nullptr;
 		uint8_t addr_list_recved = false;
-
-		AddressField addr_field;
-
-		etk::List<Socket*, 16> sockets;
+		uint32_t addr_refresh_ms = 0;
+
+		etk::List<Socket*, Config::MAX_SOCKETS> sockets;
+		ConnectionTable connections;
+
+		TxQueue txq;
+		Pacer pacer;
+		bool parsing = false;
+		bool pacer_wait = false;
+		Socket* ready = nullptr;
+		TimerWheel timers;
+		Timer addr_refresh_timer{&Interface::on_addr_refresh, this};
+		TopologyCache topology;
+#ifdef PICOLAN_NODE_BINDING
+		std::vector<uint8_t> txq_buf;
+#endif
 };
 
+#ifndef PICOLAN_LATENCY_STATS
+static_assert(sizeof(Interface) <= Config::INTERFACE_RAM,
+		"an Interface is larger than the profile's INTERFACE_RAM budget");
+#endif
+
 
 }
 
@@ -0,0 +1,172 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "ping_engine.h"
+#include "picolan.h"
+
+namespace picolan
+{
+
+constexpr uint8_t PingEngine::MAX_OUTSTANDING;
+
+PingEngine::PingEngine(Interface& iface, PingStats* stats, uint16_t len)
+	: iface(iface), stats(stats), len(len)
+{
+	for(auto& p : probes) {
+		p.engine = this;
+		p.deadline.set_callback(&PingEngine::on_probe_timeout, &p);
+	}
+	tick.set_callback(&PingEngine::on_tick, this);
+	iface.set_ping_engine(this);
+}
+
+PingEngine::~PingEngine()
+{
+	iface.set_ping_engine(nullptr);
+}
+
+bool PingEngine::add_destination(uint8_t addr)
+{
+	if(find(addr) != nullptr) {
+		return true;
+	}
+	if(used >= len) {
+		return false;
+	}
+	stats[used].reset();
+	stats[used].addr = addr;
+	used++;
+	return true;
+}
+
+PingStats* PingEngine::find(uint8_t addr)
+{
+	for(uint16_t i = 0; i < used; i++) {
+		if(stats[i].addr == addr) {
+			return &stats[i];
+		}
+	}
+	return nullptr;
+}
+
+bool PingEngine::probe(uint8_t addr)
+{
+	if(in_flight >= MAX_OUTSTANDING) {
+		return false;
+	}
+	if(!add_destination(addr)) {
+		return false;
+	}
+
+	// the slot is picked by the low bits of the sequence number, so an echo finds its probe directly
+	uint16_t seq;
+	do {
+		seq = 0x8000 | (next_seq++ & 0x7FFF);
+	} while(probes[seq % MAX_OUTSTANDING].stats != nullptr);
+
+	Probe& p = probes[seq % MAX_OUTSTANDING];
+	p.stats = find(addr);
+	p.seq = seq;
+	p.stats->sent++;
+	in_flight++;
+	iface.get_timers().schedule(p.deadline, timeout);
+
+	auto pack = iface.create_packet<ping_pack>();
+	pack.ttl = 6;
+	pack.dest_addr = addr;
+	pack.source_addr = iface.get_address();
+	pack.payload = seq;
+	p.sent_us = now_us();
+	pack.send();
+	return true;
+}
+
+void PingEngine::start(uint32_t interval_ms)
+{
+	tick_ms = (used != 0) ? (interval_ms / used) : interval_ms;
+	if(tick_ms == 0) {
+		tick_ms = 1;
+	}
+	iface.get_timers().schedule(tick, tick_ms);
+}
+
+void PingEngine::stop()
+{
+	tick.cancel();
+}
+
+void PingEngine::on_echo(uint8_t source, uint16_t seq)
+{
+	uint64_t now = now_us();
+	Probe& p = probes[seq % MAX_OUTSTANDING];
+	if((p.stats == nullptr) || (p.seq != seq) || (p.stats->addr != source)) {
+		return;
+	}
+
+	PingStats& s = *p.stats;
+	uint32_t rtt = (uint32_t)(now - p.sent_us);
+	s.rtt.record(rtt);
+	if(s.received != 0) {
+		int32_t d = (int32_t)rtt - (int32_t)s.last_rtt;
+		if(d < 0) {
+			d = -d;
+		}
+		int32_t j = (int32_t)s.jitter;
+		j += (d - j) / 16;
+		s.jitter = (uint32_t)j;
+	}
+	s.last_rtt = rtt;
+	s.received++;
+
+	p.deadline.cancel();
+	p.stats = nullptr;
+	in_flight--;
+}
+
+void PingEngine::on_probe_timeout(void* probe)
+{
+	Probe* p = (Probe*)probe;
+	if(p->stats == nullptr) {
+		return;
+	}
+	p->stats->lost++;
+	p->stats = nullptr;
+	p->engine->in_flight--;
+}
+
+void PingEngine::on_tick(void* e)
+{
+	PingEngine* pe = (PingEngine*)e;
+	if(pe->used != 0) {
+		// a destination that can't be probed now waits for its next turn
+		pe->probe(pe->stats[pe->next_dest].addr);
+		pe->next_dest = (pe->next_dest + 1) % pe->used;
+	}
+	pe->iface.get_timers().schedule(pe->tick, pe->tick_ms);
+}
+
+}
@@ -0,0 +1,223 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_PING_ENGINE_H
+#define PICOLAN_PING_ENGINE_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "histogram.h"
+#include "timer_wheel.h"
+
+namespace picolan
+{
+
+	class Interface;
+
+	/**
+	 * PingStats holds the round trip time statistics for one destination.
+	 * Times are in microseconds.
+	 */
+	struct PingStats
+	{
+		uint8_t addr = 0;
+
+		/** probes sent */
+		uint32_t sent = 0;
+		/** echoes received in time */
+		uint32_t received = 0;
+		/** probes that timed out */
+		uint32_t lost = 0;
+
+		/** the round trip times of every echo received */
+		Histogram rtt;
+
+		/**
+		 * The smoothed mean difference between consecutive round trip times,
+		 * calculated the same way as RTP interarrival jitter (RFC 3550).
+		 */
+		uint32_t jitter = 0;
+		uint32_t last_rtt = 0;
+
+		/**
+		 * \brief returns the fraction of completed probes that were lost, from 0 to 1.
+		 */
+		float loss() const {
+			uint32_t done = received + lost;
+			return done ? ((float)lost / done) : 0.0f;
+		}
+
+		void reset() {
+			sent = 0;
+			received = 0;
+			lost = 0;
+			rtt.reset();
+			jitter = 0;
+			last_rtt = 0;
+		}
+	};
+
+	/**
+	 * PingEngine measures the round trip time to many destinations at once.
+	 * Up to MAX_OUTSTANDING probes can be in flight. Each carries a sequence number so that
+	 * echoes are matched to their probe whatever order they arrive in, and the send time is
+	 * kept locally with microsecond resolution. Echoes and timeouts are handled when the
+	 * interface is serviced, so nothing blocks.
+	 *
+	 * The statistics for each destination are kept in PingStats structures provided by the
+	 * application, one per destination.
+	 *
+	 * \code
+	 * PingStats stats[200];
+	 * PingEngine engine(iface, stats, 200);
+	 * for(uint8_t a = 1; a <= 200; a++) {
+	 *     engine.add_destination(a);
+	 * }
+	 * engine.start(1000);
+	 * while(true) {
+	 *     iface.service();
+	 * }
+	 * \endcode
+	 */
+	class PingEngine
+	{
+		public:
+			static constexpr uint8_t MAX_OUTSTANDING = Config::PING_OUTSTANDING;
+
+			/**
+			 * \brief creates a ping engine and registers it with the interface.
+			 * @param iface the interface to send probes on
+			 * @param stats storage for the statistics of each destination
+			 * @param len the number of PingStats in stats, which limits the number of destinations
+			 */
+			PingEngine(Interface& iface, PingStats* stats, uint16_t len);
+
+			/**
+			 * \brief unregisters the engine from the interface.
+			 */
+			~PingEngine();
+
+			/**
+			 * \brief adds a destination to probe. Adding one that is already known does nothing.
+			 * \return false if every PingStats is in use.
+			 */
+			bool add_destination(uint8_t addr);
+
+			/**
+			 * \brief returns the statistics for a destination, or nullptr if it hasn't been added.
+			 */
+			PingStats* find(uint8_t addr);
+
+			/**
+			 * \brief returns the number of destinations.
+			 */
+			uint16_t size() const {
+				return used;
+			}
+
+			/**
+			 * \brief returns the statistics of the nth destination.
+			 */
+			PingStats& get(uint16_t n) {
+				return stats[n];
+			}
+
+			/**
+			 * \brief sets how long an echo is waited for before the probe is counted as lost.
+			 * The default is one second.
+			 */
+			void set_timeout(uint32_t ms) {
+				timeout = ms;
+			}
+
+			/**
+			 * \brief sends one probe to a destination straight away.
+			 * The destination is added if it hasn't been already.
+			 * \return false if MAX_OUTSTANDING probes are already in flight or there's no room for the destination.
+			 */
+			bool probe(uint8_t addr);
+
+			/**
+			 * \brief probes every destination once per interval. The probes are spread evenly
+			 * across the interval rather than sent in one burst.
+			 */
+			void start(uint32_t interval_ms);
+
+			/**
+			 * \brief stops periodic probing. Probes in flight still complete.
+			 */
+			void stop();
+
+			/**
+			 * \brief returns the number of probes in flight.
+			 */
+			uint8_t outstanding() const {
+				return in_flight;
+			}
+
+		private:
+			friend class Interface;
+
+			/**
+			 * \brief called by the interface when a ping echo with the engine's sequence bit arrives.
+			 */
+			void on_echo(uint8_t source, uint16_t seq);
+
+			struct Probe
+			{
+				PingEngine* engine = nullptr;
+				PingStats* stats = nullptr;
+				uint16_t seq = 0;
+				uint64_t sent_us = 0;
+				Timer deadline;
+			};
+
+			static void on_probe_timeout(void* p);
+			static void on_tick(void* e);
+
+			Interface& iface;
+			PingStats* stats;
+			uint16_t len;
+			uint16_t used = 0;
+
+			Probe probes[MAX_OUTSTANDING];
+			uint8_t in_flight = 0;
+			uint16_t next_seq = 0;
+			uint32_t timeout = 1000;
+
+			Timer tick;
+			uint32_t tick_ms = 0;
+			uint16_t next_dest = 0;
+	};
+
+}
+
+#endif
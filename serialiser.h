@@ -33,16 +33,32 @@
 #include <etk/etk.h>
 #endif
 
+#include "config.h"
 #include "address_field.h"
+#include "counters.h"
+#include "latency.h"
+#include "capture.h"
 
 
 namespace picolan
 {
 
 	/**
-	 * The maximum packet length including header and checksum bytes.
+	 * The maximum packet length including header and checksum bytes. See Config.
 	 */
-	constexpr uint16 MAX_PACKET_LENGTH = 64;
+	constexpr uint16 MAX_PACKET_LENGTH = Config::MAX_PACKET_LENGTH;
+
+	/**
+	 * The maximum length of an outgoing frame before byte stuffing, which is a packet plus its two checksum bytes.
+	 */
+	constexpr uint16 MAX_FRAME_LENGTH = MAX_PACKET_LENGTH+2;
+
+	/**
+	 * The most data a datagram packet carries, leaving 10 bytes for the header and checksum.
+	 */
+	constexpr uint16 MAX_DATAGRAM_PAYLOAD = MAX_PACKET_LENGTH-10;
+
+	static_assert(CAPTURE_FRAME_LENGTH == MAX_FRAME_LENGTH, "captured frames must hold a whole frame");
 
 	/**
 	 * Packet types.
@@ -60,6 +76,18 @@ namespace picolan
 		NULL_PACK
 	};
 
+	/**
+	 * Transmit priority classes, highest priority first.
+	 * When the Interface has a transmit queue, frames are sent by class rather than in the order they were created.
+	 */
+	enum TX_PRIORITY : uint8
+	{
+		PRIORITY_CONTROL,
+		PRIORITY_DATAGRAM,
+		PRIORITY_BULK,
+		NUM_PRIORITIES
+	};
+
 	union u64b
 	{
 		uint64 u;
@@ -85,17 +113,60 @@ namespace picolan
 
 
 	/**
-	 * SerialiserInterface defines several functions that the serialiser must implement.
-	 * The packet classes call these functions during serialisation.
+	 * Adds a byte to a running Fletcher checksum. Both sums stay below 255, so a single
+	 * subtraction reduces them, which avoids a division per byte on parts without a divider.
+	 */
+	inline void fletcher_step(uint16& s1, uint16& s2, uint8 b)
+	{
+		s1 += b;
+		if(s1 >= 255) {
+			s1 -= 255;
+		}
+		s2 += s1;
+		if(s2 >= 255) {
+			s2 -= 255;
+		}
+	}
+
+	/**
+	 * SerialiserInterface is what the packet classes serialise into.
+	 * Bytes are gathered into a frame and checksummed here without virtual calls, so the
+	 * per byte encoding loops can be inlined. Only finish() is virtual, once per frame.
 	 */
 	class SerialiserInterface
 	{
 		public:
             virtual ~SerialiserInterface() { }
-			virtual void start() = 0;
-			virtual uint16 finish_checksum() = 0;
-			virtual void send_byte(uint8 b) = 0;
-			virtual void finish() = 0;
+
+			void start() {
+				sum1 = 0;
+				sum2 = 0;
+				tx_len = 0;
+			}
+
+			uint16 finish_checksum() {
+				return (sum2 << 8) | sum1;
+			}
+
+			void send_byte(uint8 b) {
+				if(tx_len < MAX_FRAME_LENGTH) {
+					tx_frame[tx_len++] = b;
+				}
+				fletcher_step(sum1, sum2, b);
+			}
+
+			/**
+			 * \brief called when a frame is complete, with the frame in tx_frame.
+			 */
+			virtual void finish(uint8 priority) = 0;
+
+		protected:
+			uint8 tx_frame[MAX_FRAME_LENGTH];
+			uint8 tx_len = 0;
+
+		private:
+			uint16 sum1 = 0;
+			uint16 sum2 = 0;
 	};
 
 	/**
@@ -341,9 +412,14 @@ namespace picolan
 				u.u = serialiser->finish_checksum();
 				put(u.bytes[0]);
 				put(u.bytes[1]);
-				serialiser->finish();
+				serialiser->finish(priority);
 			}
 
+			/**
+			 * The transmit priority class of the packet. See TX_PRIORITY.
+			 */
+			uint8 priority = PRIORITY_CONTROL;
+
 		protected:
 			void put(uint8 b)
 			{
@@ -498,19 +574,21 @@ namespace picolan
 	};/*}}}*/
 
 	/**
-	 * datagram_pack is a packet containing data up to 54 bytes (10 bytes for header/checksum)
+	 * datagram_pack is a packet containing up to MAX_DATAGRAM_PAYLOAD bytes of data (10 bytes for header/checksum)
 	 */
 	class datagram_pack : public base_pack/*{{{*/
 	{
 		public:
-			datagram_pack(SerialiserInterface* t) : base_pack(t) { }
+			datagram_pack(SerialiserInterface* t) : base_pack(t) {
+				priority = PRIORITY_DATAGRAM;
+			}
 			static constexpr uint16 id = DATAGRAM_PACK;
 
 			uint8 ttl;
 			uint8 source_addr;
 			uint8 dest_addr;
 			uint8 port;
-			etk::List<uint8, 54> payload;
+			etk::List<uint8, MAX_DATAGRAM_PAYLOAD> payload;
 			uint8 size()
 			{
 				return (sizeof(ttl) +
@@ -595,6 +673,17 @@ namespace picolan
 			 */
 			virtual void put(uint8 b) = 0;
 
+			/**
+			 * \brief sends a block of bytes to the output stream.
+			 * The default calls put() for each byte. Override it if the stream can take a block at once.
+			 */
+			virtual void put_block(const uint8* data, uint32 len)
+			{
+				for(uint32 i = 0; i < len; i++) {
+					this->put(data[i]);
+				}
+			}
+
 			/**
 			 * \brief this function is called when a get_addr_list_pack is received
 			 */
@@ -632,12 +721,16 @@ namespace picolan
 			 */
 			void read(uint8_t c)/*{{{*/
 			{
+				counters.rx_bytes.add();
 				if((c == 0xAA) && (stuff_flag == false)) {
 					stuff_flag = true;
 				}
 				else {
 					if(stuff_flag == false) {
 						if((c == 0xAB) || (c == 0xAC)) {
+							if(state != MSG_STATE_START) {
+								counters.resyncs.add();
+							}
 							state = MSG_STATE_START;
 						}
 					}
@@ -655,8 +748,10 @@ namespace picolan
 						case MSG_STATE_ID:
 							{
 								msg_id = c;
-								if(msg_id >= NULL_PACK)
+								if(msg_id >= NULL_PACK) {
+									counters.resyncs.add();
 									state = MSG_STATE_START;
+								}
 								else
 								{
 									add_byte(c);
@@ -668,7 +763,12 @@ namespace picolan
 							{
 								add_byte(c);
 								data_length = c;
-								if(data_length == 0) {
+								// a corrupt length would run off the end of the buffer
+								if((data_length + 2u) > MAX_PACKET_LENGTH) {
+									counters.resyncs.add();
+									state = MSG_STATE_START;
+								}
+								else if(data_length == 0) {
 									state = MSG_STATE_CHECK_1;
 								}
 								else {
@@ -692,9 +792,7 @@ namespace picolan
 						case MSG_STATE_CHECK_2:
 							{
 								checksum_in += (c << 8);
-
-								if(check_checksum())
-									read_data();
+								frame_received();
 								state = MSG_STATE_START;
 							}
 							break;
@@ -705,6 +803,34 @@ namespace picolan
 			}
 			/*}}}*/
 
+			/**
+			 * \brief parses a block of bytes from the input stream.
+			 * This is the same as calling read() for each byte, but the body of a frame is
+			 * copied in runs up to the next start, end or escape byte rather than a byte at a time.
+			 */
+			void read(const uint8* data, uint32 len)
+			{
+				uint32 i = 0;
+				while(i < len) {
+					if((state == MSG_STATE_DATA) && (stuff_flag == false)) {
+						uint32 start = i;
+						uint32 want = (data_length + 2u) - data_pos;
+						while((i < len) && (want != 0) && ((data[i] < 0xAA) || (data[i] > 0xAC))) {
+							data_buf[data_pos++] = data[i++];
+							want--;
+						}
+						counters.rx_bytes.add(i - start);
+						if(want == 0) {
+							state = MSG_STATE_CHECK_1;
+						}
+						if(i == len) {
+							break;
+						}
+					}
+					read(data[i++]);
+				}
+			}
+
 			/**
 			 * Creates a packet that can be sent using this serialiser.
 			 */
@@ -716,38 +842,122 @@ namespace picolan
 
 			virtual void flush() = 0;
 
+			/**
+			 * \brief returns the frame and byte counters for this link.
+			 */
+			const LinkCounters& get_link_counters() const {
+				return counters;
+			}
 
-		private:
-			friend class base_pack;
-			void add_byte(uint8 c)
-			{
-				data_buf[data_pos++] = c;
+			/**
+			 * \brief sets the link counters back to zero.
+			 */
+			void reset_link_counters() {
+				counters.reset();
 			}
 
-			void start() {
-				reset_checksum();
-				this->put(0xAB);
+			/**
+			 * \brief records every good frame received and every frame written in a capture ring.
+			 * Received frames are captured before they are dispatched and written frames as they
+			 * go to the output stream. Capturing never blocks; frames are dropped when the ring is full.
+			 * @param ring the ring to record into, or nullptr to stop capturing
+			 */
+			void set_capture(CaptureRing* ring) {
+				capture = ring;
 			}
 
-			void finish() {
-				this->put(0xAC);
+			#ifdef PICOLAN_LATENCY_STATS
+			/**
+			 * \brief returns the latency histograms for every socket on this link combined,
+			 * and for decoding received frames.
+			 */
+			LatencyStats& get_latency() {
+				return latency;
+			}
+			#endif
+
+		protected:
+			/**
+			 * \brief called with each complete frame (header, payload and checksum, not yet byte stuffed).
+			 * The default writes it straight to the output stream. Override it to queue or schedule frames.
+			 */
+			virtual void emit_frame(const uint8* frame, uint8 len, uint8 priority)
+			{
+				etk::unused(priority);
+				write_frame(frame, len);
 				this->flush();
 			}
 
+			/**
+			 * \brief byte stuffs a frame and writes it to the output stream.
+			 */
+			void write_frame(const uint8* frame, uint8 len)
+			{
+				// stuffed into a local buffer so the stream is called once per frame rather than per byte
+				uint8 out[2*MAX_FRAME_LENGTH + 2];
+				uint32 n = 0;
+				out[n++] = 0xAB;
+				for(uint8 i = 0; i < len; i++) {
+					uint8 b = frame[i];
+					if((b >= 0xAA) && (b <= 0xAC)) {
+						out[n++] = 0xAA;
+					}
+					out[n++] = b;
+				}
+				out[n++] = 0xAC;
+				this->put_block(out, n);
+				frame_written(frame, len, n, n - len - 2u);
+			}
+
+			/**
+			 * \brief counts and captures a frame that was written by the caller rather than
+			 * write_frame(), such as to a transport that carries whole frames.
+			 * @param wire_bytes the number of bytes it took on the link
+			 * @param escapes the number of escape bytes added
+			 */
+			void frame_written(const uint8* frame, uint8 len, uint32 wire_bytes, uint32 escapes)
+			{
+				if(capture != nullptr) {
+					capture->push(CAPTURE_TX, frame, len);
+				}
+				counters.tx_frames.add();
+				counters.tx_bytes.add(wire_bytes);
+				counters.tx_escapes.add(escapes);
+			}
 
-			void reset_checksum() {
-				sum1 = 0;
-				sum2 = 0;
+			/**
+			 * \brief parses a whole frame that arrived without start, end or escape bytes,
+			 * such as a datagram from a transport that carries whole frames.
+			 * The frame is the id, size, body and checksum, as passed to emit_frame().
+			 * Frames that are malformed or fail the checksum are dropped and counted.
+			 */
+			void read_frame(const uint8* frame, uint32 len)
+			{
+				counters.rx_bytes.add(len);
+				if((len < 4) || (frame[0] >= NULL_PACK) || ((frame[1] + 4u) != len)
+						|| ((frame[1] + 2u) > MAX_PACKET_LENGTH)) {
+					counters.resyncs.add();
+					return;
+				}
+
+				msg_id = frame[0];
+				data_length = frame[1];
+				for(uint32 i = 0; i < len-2; i++) {
+					data_buf[i] = frame[i];
+				}
+				checksum_in = frame[len-2] | (frame[len-1] << 8);
+				frame_received();
 			}
 
-			void step_checksum(uint8 data) {
-				sum1 = (sum1 + data) %255;
-				sum2 = (sum2 + sum1) %255;
+		private:
+			friend class base_pack;
+			void add_byte(uint8 c)
+			{
+				data_buf[data_pos++] = c;
 			}
 
-			uint16 finish_checksum() {
-				uint16 checksum = (sum2 << 8) | sum1;
-				return checksum;
+			void finish(uint8 priority) {
+				emit_frame(tx_frame, tx_len, priority);
 			}
 
 			bool check_checksum()
@@ -756,19 +966,42 @@ namespace picolan
 				uint16 s1 = 0;
 				uint16 s2 = 0;
 				for(auto i : etk::range(len)) {
-					s1 = (s1 + (uint8)data_buf[i]) % 255;
-					s2 = (s2 + s1) %255;
+					fletcher_step(s1, s2, data_buf[i]);
 				}
 				uint16 cs = (s2 << 8) | s1;
 				return (cs == checksum_in);
 			}
 
-			void send_byte(uint8 b) {
-				if((b >= 0xAA) && (b <= 0xAC)) {
-					this->put(0xAA);
+			// called with a complete frame in data_buf
+			void frame_received()
+			{
+				if(!check_checksum()) {
+					counters.checksum_errors.add();
+					return;
+				}
+
+				counters.rx_frames.add();
+				if(capture != nullptr) {
+					capture_rx();
 				}
-				this->put(b);
-				step_checksum(b);
+				#ifdef PICOLAN_LATENCY_STATS
+				uint64_t t = now_us();
+				read_data();
+				latency.record(LATENCY_DECODE, (uint32_t)(now_us() - t));
+				#else
+				read_data();
+				#endif
+			}
+
+			void capture_rx() {
+				uint8 frame[MAX_FRAME_LENGTH];
+				uint8 len = data_length+2;
+				for(uint8 i = 0; i < len; i++) {
+					frame[i] = data_buf[i];
+				}
+				frame[len++] = checksum_in & 0xFF;
+				frame[len++] = checksum_in >> 8;
+				capture->push(CAPTURE_RX, frame, len);
 			}
 
 			void read_data()
@@ -833,14 +1066,18 @@ namespace picolan
 
 			MSG_STATE state = MSG_STATE_START;
 			bool stuff_flag = false;
-			uint16 sum1;
-			uint16 sum2;
 			uint16 msg_id = 0;
 			uint16 checksum_in = 0;
 			uint8 data_length = 0;
 			uint8 data_pos = 0;
 
 			uint8 data_buf[MAX_PACKET_LENGTH];
+
+			LinkCounters counters;
+			CaptureRing* capture = nullptr;
+			#ifdef PICOLAN_LATENCY_STATS
+			LatencyStats latency;
+			#endif
 	};
 
 
@@ -30,9 +30,15 @@
 namespace picolan
 {
 
-int Server::listen()
+constexpr uint8_t Server::MAX_BACKLOG;
+
+int Server::listen(uint8_t bl)
 {
 	if(state == CONNECTION_CLOSED) {
+		backlog = (bl > MAX_BACKLOG) ? MAX_BACKLOG : bl;
+		while(pending.size()) {
+			pending.remove(0);
+		}
 		state = CONNECTION_LISTENING;
 		return Error::NONE;
 	}
@@ -41,24 +47,47 @@ int Server::listen()
 
 bool Server::connection_pending()
 {
+	if(backlog != 0) {
+		return (pending.size() != 0);
+	}
 	return (state == CONNECTION_SYN_RECVED);
 }
 
-int Server::accept()
+uint32_t Server::pending_data(uint8_t* buffer, uint32_t len)
+{
+	if((pending.size() == 0) || !connection_pending()) {
+		return 0;
+	}
+
+	const PendingSyn& p = pending[0];
+	uint32_t n = min(len, p.len);
+	for(uint32_t i = 0; i < n; i++) {
+		buffer[i] = p.data[i];
+	}
+	return n;
+}
+
+int Server::accept(const uint8_t* reply, uint32_t len)
 {
 	if(state == CONNECTION_SYN_RECVED) {
+		if(pending.size() != 0) {
+			deliver_syn(ringbuf, pending[0]);
+			pending.remove(0);
+		}
+
+		uint64_t latency_start = latency_clock();
 		send_ack();
-		send_syn();
+		send_syn(reply, len);
 
 		//wait for ack reply
 		state = CONNECTION_PENDING;
-		auto start = millis();
+		auto start = now_ms();
 		uint32_t dt = 0;
 		do
 		{
 			iface->read();
 
-			dt = millis() - start;
+			dt = now_ms() - start;
 			if(dt > get_timeout()) {
 				disconnect();
 				return Error::TIMEOUT;
@@ -68,12 +97,125 @@ int Server::accept()
 		if(state != CONNECTION_OPEN) {
 			disconnect();
 		} else {
+			record_latency(LATENCY_ACCEPT, latency_start);
 			return Error::NONE;
 		}
 	}
 	return Error::BAD_STATE;
 }
 
+int Server::accept(Connection& conn, const uint8_t* reply, uint32_t len)
+{
+	if((state != CONNECTION_LISTENING) || (backlog == 0) || (pending.size() == 0)) {
+		return Error::BAD_STATE;
+	}
+	if(conn.state != CONNECTION_CLOSED) {
+		return Error::BAD_STATE;
+	}
+
+	PendingSyn syn = pending[0];
+	pending.remove(0);
+
+	// frames don't carry the client's port, so a second client on the same
+	// node is told to use another port by the SYN this connection sends
+	conn.iface = iface;
+	conn.port = iface->connection_port(syn.remote, port);
+	conn.remote = syn.remote;
+	conn.remote_port = syn.remote_port;
+	conn.remote_sequence = syn.sequence;
+	conn.timeout = timeout;
+	if((conn.port == 0) || !iface->register_connection(conn, syn.remote_port)) {
+		return Error::BAD_STATE;
+	}
+	deliver_syn(conn.ringbuf, syn);
+
+	uint64_t latency_start = latency_clock();
+	conn.send_ack();
+	conn.send_syn(reply, len);
+
+	//wait for ack reply
+	conn.state = CONNECTION_PENDING;
+	auto start = now_ms();
+	uint32_t dt = 0;
+	do
+	{
+		iface->read();
+
+		dt = now_ms() - start;
+		if(dt > get_timeout()) {
+			conn.disconnect();
+			return Error::TIMEOUT;
+		}
+	} while(conn.state == CONNECTION_PENDING);
+
+	if(conn.state != CONNECTION_OPEN) {
+		conn.disconnect();
+		return Error::BAD_STATE;
+	}
+	record_latency(LATENCY_ACCEPT, latency_start);
+	return Error::NONE;
+}
+
+void Server::queue_syn(uint8_t r, const uint8_t* data, uint32_t len)
+{
+	if(len < 3) {
+		return;
+	}
+
+	Socket* s = iface->find_connection(r, data[2]);
+	if(s != nullptr) {
+		Connection* old = (Connection*)s;
+
+		// the client sent its SYN again because the reply from accept() was lost
+		if(old->remote_sequence == data[1]) {
+			old->send_ack();
+			old->send_syn();
+			return;
+		}
+
+		// any other SYN from the same client port means the client has restarted,
+		// so the old connection is dead. It is not told, the client has forgotten it.
+		old->abort();
+	}
+
+	for(auto& p : pending) {
+		if((p.remote == r) && (p.remote_port == data[2])) {
+			record_syn(p, r, data, len);
+			return;
+		}
+	}
+
+	// when the backlog is full the request is dropped and the client times out
+	if(pending.size() < backlog) {
+		PendingSyn p;
+		record_syn(p, r, data, len);
+		pending.append(p);
+	}
+}
+
+void Server::record_syn(PendingSyn& p, uint8_t r, const uint8_t* data, uint32_t len)
+{
+	p.remote = r;
+	p.sequence = data[1];
+	p.remote_port = data[2];
+	p.len = 0;
+	for(uint32_t i = 3; (i < len) && (p.len < SYN_PAYLOAD_SZ); i++) {
+		p.data[p.len++] = data[i];
+	}
+}
+
+bool Server::repeated_syn(const uint8_t* data, uint32_t len)
+{
+	return (data[0] == MESSAGE_TYPE::SYN) && (len >= 3)
+		&& (data[1] == remote_sequence) && (data[2] == remote_port);
+}
+
+void Server::deliver_syn(etk::RingBuffer<uint8_t>& rb, const PendingSyn& p)
+{
+	for(uint32_t i = 0; i < p.len; i++) {
+		rb.put(p.data[i]);
+	}
+}
 
 void Server::on_data(uint8_t r, const uint8_t* data, uint32_t len)
 {
@@ -83,12 +225,27 @@ void Server::on_data(uint8_t r, const uint8_t* data, uint32_t len)
 			return;
 		case CONNECTION_LISTENING:
 			{
+				if(backlog != 0) {
+					if(data[0] == MESSAGE_TYPE::SYN) {
+						queue_syn(r, data, len);
+					}
+					return;
+				}
+
 				// expecting to receive a syn packet
-				if(data[0] == MESSAGE_TYPE::SYN) {
+				if((data[0] == MESSAGE_TYPE::SYN) && (len >= 3)) {
 					remote = r;
 					remote_sequence = data[1];
 					remote_port = data[2];
 					state = CONNECTION_SYN_RECVED;
+
+					// keep any fast open data until the connection is accepted
+					while(pending.size()) {
+						pending.remove(0);
+					}
+					PendingSyn p;
+					record_syn(p, r, data, len);
+					pending.append(p);
 				}
 			}
 			break;
@@ -110,8 +267,14 @@ void Server::on_data(uint8_t r, const uint8_t* data, uint32_t len)
 				if(remote != r) {
 					return;
 				}
+				if(repeated_syn(data, len)) {
+					send_ack();
+					send_syn();
+					return;
+				}
 				if(data[0] == MESSAGE_TYPE::ACK) {
 					state = CONNECTION_OPEN;
+					on_open();
 				}
 				if(data[0] == MESSAGE_TYPE::CLOSE) {
 					state = CONNECTION_CLOSED;
@@ -123,27 +286,16 @@ void Server::on_data(uint8_t r, const uint8_t* data, uint32_t len)
 				if(remote != r) {
 					return;
 				}
-				if(data[0] == MESSAGE_TYPE::CLOSE) {
-					state = CONNECTION_CLOSED;
-				}
-				if(data[0] == MESSAGE_TYPE::ACK) {
-					last_recved_ack = data[1];
-				}
-				if(data[0] == MESSAGE_TYPE::DATA) {
-					uint8_t next_sequence = remote_sequence+1;
-					if(data[1] == next_sequence) {
-						remote_sequence = next_sequence;
-						for(uint32_t i = 2; i < len; i++) {
-							ringbuf.put(data[i]);
-						}
-
-					} else {
-					}
+				if(repeated_syn(data, len)) {
 					send_ack();
+					send_syn();
+					return;
 				}
+				on_stream_data(data, len);
 			}
 			break;
 			case CONNECTION_SYN_SENT:
+			case CONNECTION_FAST_OPEN:
 			break;
 
 	}
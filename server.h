@@ -27,6 +27,7 @@
 #define PICOLAN_SERVER_H
 
 #include "socket_stream.h"
+#include "connection.h"
 
 namespace picolan
 {
@@ -64,10 +65,25 @@ namespace picolan
 			}
 
 			/**
-			 * \brief starts the server listening
+			 * \brief the maximum number of connection requests that can wait to be accepted.
+			 * Set by Config::MAX_BACKLOG.
+			 */
+			static constexpr uint8_t MAX_BACKLOG = Config::MAX_BACKLOG;
+
+			/**
+			 * \brief starts the server listening.
+			 * With a backlog of zero the server accepts one client at a time and the
+			 * server itself becomes the connection (see accept()).
+			 * With a backlog greater than zero, up to that many connection requests are
+			 * queued and each one is accepted into its own Connection object with
+			 * accept(Connection&). The server keeps listening while connections are open.
+			 * Requests are told apart by the client's address and port. A repeated SYN
+			 * from a client that is already connected is answered again, while a SYN with
+			 * a new sequence number closes the old connection because the client has restarted.
+			 * @param backlog the number of connection requests to queue, up to MAX_BACKLOG.
 			 * \return either ERROR_NONE or ERROR_BAD_STATE
 			 */
-			int listen();
+			int listen(uint8_t backlog = 0);
 
 			/**
 			 * \brief checks if a client is attempting to connect.
@@ -75,14 +91,53 @@ namespace picolan
 			 */
 			bool connection_pending();
 
+			/**
+			 * \brief copies the data a fast open client sent with its connection request.
+			 * This lets the server prepare a reply to send with accept() before the
+			 * connection is open. The data is still delivered to the connection when it is accepted.
+			 * @param buffer where to copy the data
+			 * @param len the size of buffer
+			 * \return the number of bytes copied. Zero if no request is pending or it carried no data.
+			 */
+			uint32_t pending_data(uint8_t* buffer, uint32_t len);
+
 			/**
 			 * \brief accepts the pending client connection
+			 * Any data the client sent with its connection request (see Client::set_fast_open())
+			 * is available to read once the connection is accepted.
+			 * @param reply optional data to send to the client with the SYN
+			 * @param len the length of the reply, up to 51 bytes
 			 * \returns either ERROR_NONE or another error code
 			 */
-			int accept();
+			int accept(const uint8_t* reply = nullptr, uint32_t len = 0);
+
+			/**
+			 * \brief accepts the oldest queued connection request into conn.
+			 * The server must be listening with a backlog. The connection must be closed.
+			 * @param conn the connection object that will serve this client
+			 * @param reply optional data to send to the client with the SYN
+			 * @param len the length of the reply, up to 51 bytes
+			 * \returns either ERROR_NONE, ERROR_TIMEOUT or ERROR_BAD_STATE
+			 */
+			int accept(Connection& conn, const uint8_t* reply = nullptr, uint32_t len = 0);
 
 		private:
+			struct PendingSyn {
+				uint8_t remote;
+				uint8_t remote_port;
+				uint8_t sequence;
+				uint8_t len;
+				uint8_t data[SYN_PAYLOAD_SZ];
+			};
+
 			void on_data(uint8_t remote, const uint8_t* data, uint32_t len);
+			void queue_syn(uint8_t remote, const uint8_t* data, uint32_t len);
+			static void record_syn(PendingSyn& p, uint8_t remote, const uint8_t* data, uint32_t len);
+			bool repeated_syn(const uint8_t* data, uint32_t len);
+			static void deliver_syn(etk::RingBuffer<uint8_t>& rb, const PendingSyn& p);
+
+			uint8_t backlog = 0;
+			etk::List<PendingSyn, MAX_BACKLOG> pending;
 	};
 }
 
@@ -0,0 +1,311 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "shm_transport.h"
+
+#ifdef __linux__
+
+#include "socket.h"
+#include "serialiser.h"
+
+#include <new>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace picolan
+{
+
+constexpr uint32_t ShmTransport::DEFAULT_SLOTS;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory rings need lock free atomics");
+
+namespace
+{
+
+constexpr uint32_t SEGMENT_MAGIC = 0x504C5348;
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+struct Slot
+{
+	uint8_t len;
+	uint8_t frame[MAX_FRAME_LENGTH];
+};
+
+int futex(std::atomic<uint32_t>* word, int op, uint32_t val, const struct timespec* timeout)
+{
+	return syscall(SYS_futex, (uint32_t*)word, op, val, timeout, nullptr, 0);
+}
+
+}
+
+// the producer and consumer indexes are on separate cache lines so the two
+// processes don't fight over one line
+struct ShmTransport::Ring
+{
+	alignas(64) std::atomic<uint32_t> head;
+	alignas(64) std::atomic<uint32_t> tail;
+	std::atomic<uint32_t> sleeping;
+	alignas(64) Slot slots[1];
+};
+
+struct ShmTransport::Segment
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t ring_size;
+
+	// size is passed in rather than read from the header, which the other process can change
+	Ring* ring(uint32_t i, uint32_t size) {
+		return (Ring*)((uint8_t*)this + 64 + i*size);
+	}
+};
+
+ShmTransport::~ShmTransport()
+{
+	close();
+}
+
+int ShmTransport::create(const std::string& n, uint32_t slots)
+{
+	close();
+	if((slots == 0) || ((slots & (slots-1)) != 0)) {
+		return Error::IO;
+	}
+
+	int fd;
+	if(n.empty()) {
+		fd = syscall(SYS_memfd_create, "picolan", MFD_CLOEXEC);
+	} else {
+		fd = shm_open(n.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		name = n;
+	}
+	if(fd < 0) {
+		name.clear();
+		return Error::IO;
+	}
+	return map(fd, true, slots);
+}
+
+int ShmTransport::attach(const std::string& n)
+{
+	close();
+	int fd = shm_open(n.c_str(), O_RDWR | O_CLOEXEC, 0);
+	if(fd < 0) {
+		return Error::IO;
+	}
+	return map(fd, false, 0);
+}
+
+int ShmTransport::attach_fd(int fd)
+{
+	close();
+	if(fd < 0) {
+		return Error::IO;
+	}
+	return map(fd, false, 0);
+}
+
+int ShmTransport::map(int fd, bool creator, uint32_t slots)
+{
+	segment_fd = fd;
+
+	uint32_t ring_size = (offsetof(Ring, slots) + slots*sizeof(Slot) + 63) & ~63u;
+	if(creator) {
+		segment_size = 64 + 2*ring_size;
+		if(ftruncate(fd, segment_size) != 0) {
+			close();
+			return Error::IO;
+		}
+	} else {
+		struct stat st;
+		if((fstat(fd, &st) != 0) || (st.st_size < 64)) {
+			close();
+			return Error::IO;
+		}
+		segment_size = st.st_size;
+	}
+
+	void* p = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED) {
+		close();
+		return Error::IO;
+	}
+	segment = (Segment*)p;
+
+	// the creator sends on ring 0 and receives on ring 1, the other side the reverse
+	if(creator) {
+		segment->version = SEGMENT_VERSION;
+		segment->slots = slots;
+		segment->ring_size = ring_size;
+		for(uint32_t i = 0; i < 2; i++) {
+			Ring* r = segment->ring(i, ring_size);
+			new (&r->head) std::atomic<uint32_t>(0);
+			new (&r->tail) std::atomic<uint32_t>(0);
+			new (&r->sleeping) std::atomic<uint32_t>(0);
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		segment->magic = SEGMENT_MAGIC;
+		tx = segment->ring(0, ring_size);
+		rx = segment->ring(1, ring_size);
+	} else {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		slots = segment->slots;
+		ring_size = segment->ring_size;
+		// the ring mask and slot array are only trusted once they fit the segment
+		uint64_t needed = offsetof(Ring, slots) + (uint64_t)slots*sizeof(Slot);
+		if((segment->magic != SEGMENT_MAGIC) || (segment->version != SEGMENT_VERSION)
+				|| (slots == 0) || ((slots & (slots-1)) != 0)
+				|| ((ring_size % 64) != 0) || (needed > ring_size)
+				|| (64 + 2*(uint64_t)ring_size > segment_size)) {
+			close();
+			return Error::IO;
+		}
+		tx = segment->ring(1, ring_size);
+		rx = segment->ring(0, ring_size);
+	}
+	ring_slots = slots;
+	return Error::NONE;
+}
+
+void ShmTransport::close()
+{
+	if(segment != nullptr) {
+		munmap(segment, segment_size);
+		segment = nullptr;
+	}
+	if(segment_fd >= 0) {
+		::close(segment_fd);
+		segment_fd = -1;
+	}
+	if(!name.empty()) {
+		shm_unlink(name.c_str());
+		name.clear();
+	}
+	rx = nullptr;
+	tx = nullptr;
+	ring_slots = 0;
+}
+
+int ShmTransport::read(uint8_t* buffer, uint32_t len)
+{
+	if(segment == nullptr) {
+		return Error::IO;
+	}
+	uint32_t t = rx->tail.load(std::memory_order_relaxed);
+	if(t == rx->head.load(std::memory_order_acquire)) {
+		return 0;
+	}
+
+	const Slot& s = rx->slots[t & (ring_slots-1)];
+	uint32_t n = (s.len < MAX_FRAME_LENGTH) ? s.len : MAX_FRAME_LENGTH;
+	if(n > len) {
+		n = len;
+	}
+	memcpy(buffer, s.frame, n);
+	rx->tail.store(t+1, std::memory_order_release);
+	return n;
+}
+
+int ShmTransport::write(const uint8_t* buffer, uint32_t len)
+{
+	if(segment == nullptr) {
+		return Error::IO;
+	}
+	if(len > MAX_FRAME_LENGTH) {
+		len = MAX_FRAME_LENGTH;
+	}
+
+	uint32_t h = tx->head.load(std::memory_order_relaxed);
+	if((h - tx->tail.load(std::memory_order_acquire)) >= ring_slots) {
+		dropped.add();
+		return 0;
+	}
+
+	Slot& s = tx->slots[h & (ring_slots-1)];
+	s.len = len;
+	memcpy(s.frame, buffer, len);
+	tx->head.store(h+1, std::memory_order_release);
+
+	// pairs with the fence in wait(), so either the reader sees the new head
+	// before it sleeps or this sees that it is sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(tx->sleeping.load(std::memory_order_relaxed) != 0) {
+		futex(&tx->head, FUTEX_WAKE, 1, nullptr);
+	}
+	return len;
+}
+
+uint32_t ShmTransport::available()
+{
+	if(segment == nullptr) {
+		return 0;
+	}
+	uint32_t t = rx->tail.load(std::memory_order_relaxed);
+	if(t == rx->head.load(std::memory_order_acquire)) {
+		return 0;
+	}
+	uint32_t n = rx->slots[t & (ring_slots-1)].len;
+	return (n < MAX_FRAME_LENGTH) ? n : MAX_FRAME_LENGTH;
+}
+
+bool ShmTransport::wait(uint32_t timeout_ms)
+{
+	if(segment == nullptr) {
+		return false;
+	}
+
+	uint32_t t = rx->tail.load(std::memory_order_relaxed);
+	uint32_t h = rx->head.load(std::memory_order_acquire);
+	if(h != t) {
+		return true;
+	}
+
+	rx->sleeping.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	h = rx->head.load(std::memory_order_relaxed);
+	if(h == t) {
+		struct timespec ts;
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		futex(&rx->head, FUTEX_WAIT, h, &ts);
+	}
+	rx->sleeping.store(0, std::memory_order_relaxed);
+	return rx->head.load(std::memory_order_acquire) != t;
+}
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_SHM_TRANSPORT_H
+#define PICOLAN_SHM_TRANSPORT_H
+
+#ifdef __linux__
+
+#include <string>
+#include <atomic>
+#include "transport.h"
+#include "counters.h"
+
+namespace picolan
+{
+
+	/**
+	 * ShmTransport connects two processes on the same host through a shared memory segment.
+	 * The segment holds a lock free single producer, single consumer ring of frames in each
+	 * direction, so frames move without system calls or byte stuffing. The only system call on
+	 * the data path is a futex wake, made when the reader is asleep in wait().
+	 *
+	 * One process creates the segment and the other attaches to it, either by name or by a file
+	 * descriptor passed over a Unix domain socket. This lets local processes act as interfaces of
+	 * a daemon that owns the serial port. When a ring is full, frames are dropped and counted,
+	 * and the protocol recovers from that the same way it does from a lost frame.
+	 *
+	 * There is no descriptor to poll, so use wait() to sleep until a frame arrives.
+	 */
+	class ShmTransport : public Transport
+	{
+		public:
+			static constexpr uint32_t DEFAULT_SLOTS = 256;
+
+			ShmTransport() { }
+			~ShmTransport();
+
+			ShmTransport(const ShmTransport&) = delete;
+			ShmTransport& operator=(const ShmTransport&) = delete;
+
+			/**
+			 * \brief creates a segment.
+			 * @param name the POSIX shared memory name, such as "/picolan-gw". If empty, an anonymous
+			 * memfd is created and can be shared with get_segment_fd().
+			 * @param slots the number of frames each ring holds, a power of two
+			 * \return Error::NONE or Error::IO
+			 */
+			int create(const std::string& name, uint32_t slots = DEFAULT_SLOTS);
+
+			/**
+			 * \brief attaches to a segment created by another process.
+			 * \return Error::NONE, or Error::IO if it doesn't exist or isn't a PicoLAN segment
+			 */
+			int attach(const std::string& name);
+
+			/**
+			 * \brief attaches to a segment from a file descriptor. The transport takes ownership of it.
+			 * \return Error::NONE or Error::IO
+			 */
+			int attach_fd(int fd);
+
+			/**
+			 * \brief detaches from the segment. A named segment is removed by the process that created it.
+			 */
+			void close();
+
+			bool is_open() const {
+				return segment != nullptr;
+			}
+
+			int read(uint8_t* buffer, uint32_t len);
+			int write(const uint8_t* buffer, uint32_t len);
+			uint32_t available();
+
+			bool is_framed() const {
+				return true;
+			}
+
+			/**
+			 * \brief sleeps until a frame arrives.
+			 * \return true if a frame is waiting, false on timeout
+			 */
+			bool wait(uint32_t timeout_ms);
+
+			/**
+			 * \brief returns the descriptor of the segment, to pass to another process.
+			 */
+			int get_segment_fd() const {
+				return segment_fd;
+			}
+
+			/**
+			 * \brief returns the number of frames dropped because the other process wasn't keeping up.
+			 */
+			uint32_t get_dropped() const {
+				return dropped.get();
+			}
+
+		private:
+			struct Ring;
+			struct Segment;
+
+			int map(int fd, bool creator, uint32_t slots);
+
+			Segment* segment = nullptr;
+			uint32_t segment_size = 0;
+			// checked when the segment is mapped, because the other process can write the header
+			uint32_t ring_slots = 0;
+			int segment_fd = -1;
+			Ring* rx = nullptr;
+			Ring* tx = nullptr;
+			std::string name;
+			Counter dropped;
+	};
+
+}
+
+#endif
+
+#endif
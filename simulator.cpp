@@ -0,0 +1,376 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "simulator.h"
+
+#ifdef __linux__
+
+#include <string.h>
+#include "picolan.h"
+
+namespace picolan
+{
+
+constexpr uint32_t Simulator::DEFAULT_STACK;
+constexpr uint32_t Simulator::DEFAULT_TICK_US;
+
+// makecontext() can only pass int arguments, so a starting task finds its simulator here
+static Simulator* starting = nullptr;
+
+int SimEndpoint::read(uint8_t* buffer, uint32_t len)
+{
+	if(rx.empty() && (sim->current != nullptr)) {
+		sim->idle();
+	}
+	if(rx.empty()) {
+		return 0;
+	}
+
+	Frame& f = rx.front();
+	uint32_t n = (f.len < len) ? f.len : len;
+	memcpy(buffer, f.data, n);
+	rx_bytes -= f.len;
+	rx.pop_front();
+	sim->progress = true;
+	return n;
+}
+
+uint32_t SimEndpoint::available()
+{
+	if(rx.empty() && (sim->current != nullptr)) {
+		sim->idle();
+	}
+	return rx_bytes;
+}
+
+int SimEndpoint::write(const uint8_t* buffer, uint32_t len)
+{
+	if((len == 0) || (len > MAX_FRAME_LENGTH)) {
+		return Error::IO;
+	}
+
+	const LinkParams& p = link->params;
+	uint64_t now = sim->now_us();
+	sim->progress = true;
+	stats.frames++;
+	stats.bytes += len;
+
+	// frames queue behind each other for the wire, stuffing and all
+	uint64_t start = (busy_until > now) ? busy_until : now;
+	uint64_t tx_us = 0;
+	if(p.baud != 0) {
+		tx_us = (uint64_t)Pacer::wire_length(buffer, len)*10*1000000/p.baud;
+	}
+	busy_until = start + tx_us;
+
+	if(sim->chance(p.loss)) {
+		stats.lost++;
+	}
+	else {
+		Frame f;
+		f.at = busy_until + p.delay_us;
+		f.len = len;
+		memcpy(f.data, buffer, len);
+
+		if(p.bit_error_rate > 0) {
+			bool damaged = false;
+			for(uint32_t i = 0; i < len*8; i++) {
+				if(sim->chance(p.bit_error_rate)) {
+					f.data[i/8] ^= (1 << (i%8));
+					damaged = true;
+				}
+			}
+			if(damaged) {
+				stats.corrupted++;
+			}
+		}
+
+		if(sim->chance(p.reorder)) {
+			f.at += p.reorder_us;
+			stats.reordered++;
+		}
+
+		// frames usually arrive in order, so the search is short
+		auto it = in_flight.end();
+		while((it != in_flight.begin()) && ((it-1)->at > f.at)) {
+			--it;
+		}
+		in_flight.insert(it, f);
+	}
+
+	// a writer can only get so far ahead of the wire before it has to wait, as on a serial port
+	if((p.baud != 0) && (sim->current != nullptr)) {
+		uint64_t ahead = (uint64_t)p.tx_depth*10*1000000/p.baud;
+		if(busy_until > now + ahead) {
+			sim->wait_until(busy_until - ahead);
+		}
+	}
+	return len;
+}
+
+void SimEndpoint::deliver(uint64_t now)
+{
+	uint32_t depth = link->params.depth;
+	while(!in_flight.empty() && (in_flight.front().at <= now)) {
+		Frame& f = in_flight.front();
+		if((depth != 0) && (peer->rx_bytes + f.len > depth)) {
+			stats.overruns++;
+		}
+		else {
+			peer->rx.push_back(f);
+			peer->rx_bytes += f.len;
+			stats.delivered++;
+			sim->progress = true;
+		}
+		in_flight.pop_front();
+	}
+}
+
+
+Simulator::Simulator(uint32_t seed)
+{
+	rng = (seed == 0) ? 1 : seed;
+	previous_source = time_source_ptr();
+	set_time_source(&clock);
+}
+
+Simulator::~Simulator()
+{
+	// tasks that haven't returned are abandoned, and their stacks aren't unwound
+	set_time_source(previous_source);
+}
+
+SimLink& Simulator::add_link(const LinkParams& params)
+{
+	links.emplace_back(new SimLink());
+	SimLink& l = *links.back();
+	l.params = params;
+	l.end_a.sim = this;
+	l.end_a.link = &l;
+	l.end_a.peer = &l.end_b;
+	l.end_b.sim = this;
+	l.end_b.link = &l;
+	l.end_b.peer = &l.end_a;
+	return l;
+}
+
+SoftSwitch& Simulator::add_switch()
+{
+	switches.emplace_back(new SoftSwitch());
+	SoftSwitch* sw = switches.back().get();
+	spawn([this, sw]() {
+		while(true) {
+			sw->service();
+			idle();
+		}
+	});
+	tasks.back()->daemon = true;
+	return *sw;
+}
+
+SimEndpoint& Simulator::attach(SoftSwitch& sw, const LinkParams& params)
+{
+	SimLink& l = add_link(params);
+	sw.add_port(l.a());
+	return l.b();
+}
+
+SimLink& Simulator::connect(SoftSwitch& a, SoftSwitch& b, const LinkParams& params)
+{
+	SimLink& l = add_link(params);
+	a.add_port(l.a());
+	b.add_port(l.b());
+	return l;
+}
+
+void Simulator::spawn(std::function<void()> fn, uint32_t stack_size)
+{
+	tasks.emplace_back(new Task());
+	Task& t = *tasks.back();
+	t.fn = fn;
+	t.stack.reset(new uint8_t[stack_size]);
+	getcontext(&t.context);
+	t.context.uc_stack.ss_sp = t.stack.get();
+	t.context.uc_stack.ss_size = stack_size;
+	t.context.uc_link = &scheduler;
+	makecontext(&t.context, trampoline, 0);
+}
+
+void Simulator::trampoline()
+{
+	Simulator* sim = starting;
+	sim->current->fn();
+	sim->current->finished = true;
+}
+
+void Simulator::start(Task& t)
+{
+	current = &t;
+	starting = this;
+	swapcontext(&scheduler, &t.context);
+	current = nullptr;
+}
+
+bool Simulator::run_for(uint32_t ms)
+{
+	uint64_t end = clock.now_us() + (uint64_t)ms*1000;
+	while(true) {
+		if(tasks_done() || (clock.now_us() >= end)) {
+			return tasks_done();
+		}
+
+		progress = false;
+		polling = false;
+		uint64_t now = clock.now_us();
+		// tasks spawned during the round wait for the next one
+		size_t n = tasks.size();
+		for(size_t i = 0; i < n; i++) {
+			Task& t = *tasks[i];
+			if(!t.finished && (t.wake_at <= now)) {
+				start(t);
+			}
+		}
+		deliver_all();
+
+		// the clock stops where the last task returned
+		if(progress || tasks_done()) {
+			continue;
+		}
+
+		// nothing moved, so let time pass until something can happen
+		uint64_t target = next_event();
+		if(polling && (target > now + tick_us)) {
+			target = now + tick_us;
+		}
+		if(target > end) {
+			target = end;
+		}
+		if(target <= now) {
+			target = now + 1;
+		}
+		clock.set_us(target);
+		deliver_all();
+	}
+}
+
+bool Simulator::tasks_done() const
+{
+	for(auto& t : tasks) {
+		if(!t->finished && !t->daemon) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Simulator::sleep_ms(uint32_t ms)
+{
+	wait_until(clock.now_us() + (uint64_t)ms*1000);
+}
+
+void Simulator::yield()
+{
+	if(current != nullptr) {
+		idle();
+	}
+}
+
+void Simulator::idle()
+{
+	polling = true;
+	current->wake_at = 0;
+	switch_out();
+}
+
+void Simulator::wait_until(uint64_t us)
+{
+	if(current == nullptr) {
+		if(us > clock.now_us()) {
+			clock.set_us(us);
+		}
+		deliver_all();
+		return;
+	}
+	current->wake_at = us;
+	switch_out();
+}
+
+void Simulator::switch_out()
+{
+	Task* t = current;
+	swapcontext(&t->context, &scheduler);
+}
+
+void Simulator::deliver_all()
+{
+	uint64_t now = clock.now_us();
+	for(auto& l : links) {
+		l->end_a.deliver(now);
+		l->end_b.deliver(now);
+	}
+}
+
+uint64_t Simulator::next_event()
+{
+	uint64_t next = UINT64_MAX;
+	for(auto& l : links) {
+		if(!l->end_a.in_flight.empty() && (l->end_a.in_flight.front().at < next)) {
+			next = l->end_a.in_flight.front().at;
+		}
+		if(!l->end_b.in_flight.empty() && (l->end_b.in_flight.front().at < next)) {
+			next = l->end_b.in_flight.front().at;
+		}
+	}
+	uint64_t now = clock.now_us();
+	for(auto& t : tasks) {
+		if(!t->finished && (t->wake_at > now) && (t->wake_at < next)) {
+			next = t->wake_at;
+		}
+	}
+	return next;
+}
+
+// xorshift32, which is plenty for impairments and keeps runs repeatable
+uint32_t Simulator::random()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+bool Simulator::chance(double p)
+{
+	if(p <= 0) {
+		return false;
+	}
+	return random() < (p*4294967296.0);
+}
+
+}
+
+#endif
@@ -0,0 +1,350 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_SIMULATOR_H
+#define PICOLAN_SIMULATOR_H
+
+#ifdef __linux__
+
+#include <ucontext.h>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "transport.h"
+#include "serialiser.h"
+#include "pacer.h"
+#include "soft_switch.h"
+#include "ulan_time.h"
+
+namespace picolan
+{
+
+	class Simulator;
+	class SimLink;
+
+	/**
+	 * LinkParams describes a simulated link. The same impairments apply in both directions,
+	 * and each direction is impaired independently.
+	 */
+	struct LinkParams
+	{
+		/** the baud rate, with ten bit times a byte as on an 8N1 UART. Zero sends frames instantly. */
+		uint32_t baud = 115200;
+
+		/** the time from the end of a frame leaving one end to it arriving at the other */
+		uint32_t delay_us = 0;
+
+		/** the chance of a frame being lost, from 0 to 1 */
+		double loss = 0;
+
+		/** the chance of each bit being flipped. The receiver's checksum catches the damage. */
+		double bit_error_rate = 0;
+
+		/** the chance of a frame being held back by reorder_us, so later frames overtake it */
+		double reorder = 0;
+		uint32_t reorder_us = 2000;
+
+		/**
+		 * The receive buffer of each end in bytes. Frames that arrive while it is full are dropped,
+		 * as a UART driver drops bytes when its buffer overruns. Zero is unlimited.
+		 */
+		uint32_t depth = 0;
+
+		/**
+		 * The bytes a writer can get ahead of the wire before write() waits, like the transmit
+		 * buffer of a serial driver. Only applies when the baud rate is set.
+		 */
+		uint32_t tx_depth = 128;
+	};
+
+
+	/**
+	 * SimLinkStats counts what happened to the frames sent in one direction of a link.
+	 */
+	struct SimLinkStats
+	{
+		uint32_t frames = 0;
+		uint32_t bytes = 0;
+		uint32_t delivered = 0;
+		uint32_t lost = 0;
+		uint32_t corrupted = 0;
+		uint32_t reordered = 0;
+		uint32_t overruns = 0;
+	};
+
+
+	/**
+	 * SimEndpoint is one end of a simulated link. It is a framed transport, so interfaces and
+	 * switches use it like a UDP socket.
+	 *
+	 * When a simulated task finds nothing to read, the endpoint gives the other tasks a turn.
+	 * That is what lets blocking calls such as Client::connect() and Socket::read() run inside
+	 * a task while the virtual clock moves on around them.
+	 */
+	class SimEndpoint : public Transport
+	{
+		public:
+			int read(uint8_t* buffer, uint32_t len);
+			int write(const uint8_t* buffer, uint32_t len);
+			uint32_t available();
+
+			bool is_framed() const {
+				return true;
+			}
+
+			/**
+			 * \brief returns the statistics for frames sent from this end.
+			 */
+			const SimLinkStats& get_stats() const {
+				return stats;
+			}
+
+		private:
+			friend class SimLink;
+			friend class Simulator;
+
+			struct Frame
+			{
+				uint64_t at;
+				uint8_t len;
+				uint8_t data[MAX_FRAME_LENGTH];
+			};
+
+			void deliver(uint64_t now);
+
+			Simulator* sim = nullptr;
+			SimLink* link = nullptr;
+			SimEndpoint* peer = nullptr;
+
+			// frames on their way to the peer, in the order they arrive
+			std::deque<Frame> in_flight;
+			uint64_t busy_until = 0;
+
+			// frames that have arrived here and are waiting to be read
+			std::deque<Frame> rx;
+			uint32_t rx_bytes = 0;
+
+			SimLinkStats stats;
+	};
+
+
+	/**
+	 * SimLink is a simulated link between two endpoints.
+	 */
+	class SimLink
+	{
+		public:
+			SimEndpoint& a() {
+				return end_a;
+			}
+
+			SimEndpoint& b() {
+				return end_b;
+			}
+
+			const LinkParams& get_params() const {
+				return params;
+			}
+
+			/**
+			 * \brief changes the impairments. Frames already on the link keep the ones they were sent with.
+			 */
+			void set_params(const LinkParams& p) {
+				params = p;
+			}
+
+		private:
+			friend class Simulator;
+			friend class SimEndpoint;
+
+			LinkParams params;
+			SimEndpoint end_a;
+			SimEndpoint end_b;
+	};
+
+
+	/**
+	 * Simulator runs a network of interfaces and switches in one process, on a virtual clock,
+	 * so protocol behaviour can be measured and reproduced without hardware. An hour of traffic
+	 * takes a few seconds, and a run with the same seed always does the same thing.
+	 *
+	 * Each node is a task with its own stack, written like a program on a real device. Tasks
+	 * take turns. A task runs until it waits for input or calls sleep_ms(), then the next task
+	 * runs. When every task is waiting, the clock jumps to the next frame arrival or wake up,
+	 * but never more than a tick at a time while tasks are polling, so their timeouts expire
+	 * on time. A task must wait through the library or sleep_ms(), never by spinning on its own.
+	 *
+	 * The simulator replaces the library time source while it exists, so create it before any
+	 * interface, and create interfaces inside tasks or after it.
+	 *
+	 * \code
+	 * Simulator sim;
+	 * LinkParams lossy;
+	 * lossy.loss = 0.02;
+	 * SoftSwitch& sw = sim.add_switch();
+	 * Transport& a = sim.attach(sw, lossy);
+	 * Transport& b = sim.attach(sw, lossy);
+	 *
+	 * sim.spawn([&]() {
+	 *     Interface iface(a);
+	 *     iface.set_address(1);
+	 *     ...
+	 * });
+	 * sim.spawn([&]() {
+	 *     Interface iface(b);
+	 *     iface.set_address(2);
+	 *     ...
+	 * });
+	 * sim.run_for(60*60*1000);
+	 * \endcode
+	 */
+	class Simulator
+	{
+		public:
+			static constexpr uint32_t DEFAULT_STACK = 256*1024;
+			static constexpr uint32_t DEFAULT_TICK_US = 1000;
+
+			/**
+			 * @param seed seeds the random impairments. Runs with the same seed are identical.
+			 */
+			Simulator(uint32_t seed = 1);
+			~Simulator();
+
+			Simulator(const Simulator&) = delete;
+			Simulator& operator=(const Simulator&) = delete;
+
+			/**
+			 * \brief creates a link between two endpoints.
+			 */
+			SimLink& add_link(const LinkParams& params = LinkParams());
+
+			/**
+			 * \brief creates a switch, which runs as a task of its own.
+			 */
+			SoftSwitch& add_switch();
+
+			/**
+			 * \brief connects a new link to a switch port.
+			 * \return the other end of the link, for a node or another switch
+			 */
+			SimEndpoint& attach(SoftSwitch& sw, const LinkParams& params = LinkParams());
+
+			/**
+			 * \brief connects two switches with a new link.
+			 */
+			SimLink& connect(SoftSwitch& a, SoftSwitch& b, const LinkParams& params = LinkParams());
+
+			/**
+			 * \brief adds a task. It starts on the next call to run_for().
+			 */
+			void spawn(std::function<void()> fn, uint32_t stack_size = DEFAULT_STACK);
+
+			/**
+			 * \brief runs the tasks until they have all returned or ms milliseconds of virtual
+			 * time have passed. Tasks that haven't returned carry on in the next call.
+			 * \return true if every task has returned
+			 */
+			bool run_for(uint32_t ms);
+
+			/**
+			 * \brief lets virtual time pass for the calling task. Outside a task it moves the clock on.
+			 */
+			void sleep_ms(uint32_t ms);
+
+			/**
+			 * \brief gives the other tasks a turn, as waiting for input does.
+			 */
+			void yield();
+
+			/**
+			 * \brief sets the largest step the clock takes while tasks are polling.
+			 */
+			void set_tick_us(uint32_t us) {
+				tick_us = (us == 0) ? 1 : us;
+			}
+
+			uint64_t now_us() {
+				return clock.now_us();
+			}
+
+			/**
+			 * \brief returns a random number from the simulation's generator, for tasks that need
+			 * random behaviour that is still repeatable.
+			 */
+			uint32_t random();
+
+			/**
+			 * \brief returns true with the chance p.
+			 */
+			bool chance(double p);
+
+		private:
+			friend class SimEndpoint;
+
+			struct Task
+			{
+				std::function<void()> fn;
+				ucontext_t context;
+				std::unique_ptr<uint8_t[]> stack;
+				uint64_t wake_at = 0;
+				bool daemon = false;
+				bool finished = false;
+			};
+
+			static void trampoline();
+
+			void start(Task& t);
+
+			// called by a task that found nothing to read
+			void idle();
+			void wait_until(uint64_t us);
+			void switch_out();
+			void deliver_all();
+			uint64_t next_event();
+			bool tasks_done() const;
+
+			VirtualClock clock;
+			TimeSource* previous_source;
+			uint32_t rng;
+			uint32_t tick_us = DEFAULT_TICK_US;
+
+			std::vector<std::unique_ptr<Task>> tasks;
+			std::vector<std::unique_ptr<SimLink>> links;
+			std::vector<std::unique_ptr<SoftSwitch>> switches;
+
+			ucontext_t scheduler;
+			Task* current = nullptr;
+			bool progress = false;
+			bool polling = false;
+	};
+
+}
+
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "socket.h"
 #include "picolan.h"
+#include "fec.h"
 
 namespace picolan
 {
@@ -16,19 +17,20 @@ uint32_t Socket::available() {
 
 int Socket::timedRead() {
 	uint32_t dt = 0;
-	auto startMillis = millis();
+	auto startMillis = now_ms();
 	do {
 		if(ringbuf.available() > 0) {
 			return ringbuf.get();
 		}
 		iface->read();
-		dt = millis() - startMillis;
+		dt = now_ms() - startMillis;
 	} while(dt < timeout);
 	return Error::TIMEOUT;
 }
 
 #ifndef PICOLAN_NODE_BINDING
 uint32_t Socket::read(uint8_t* buffer, uint32_t len) {
+	uint64_t start = latency_clock();
 	uint32_t count = 0;
 	while(count < len) {
 		auto c = timedRead();
@@ -37,10 +39,12 @@ uint32_t Socket::read(uint8_t* buffer, uint32_t len) {
 		}
 		buffer[count++] = c;
 	}
+	record_latency(LATENCY_READ, start);
 	return count;
 }
 #else
 std::vector<uint8_t> Socket::read(uint32_t len) {
+	uint64_t start = latency_clock();
 	std::vector<uint8_t> ret;
 	while(ret.size() < len) {
 		int c = timedRead();
@@ -49,10 +53,35 @@ std::vector<uint8_t> Socket::read(uint32_t len) {
 		}
 		ret.push_back(c);
 	}
+	record_latency(LATENCY_READ, start);
 	return ret;
 }
 #endif
 
+#ifdef PICOLAN_LATENCY_STATS
+void Socket::record_latency_us(uint8_t op, uint32_t us) {
+	latency.record(op, us);
+	if(iface != nullptr) {
+		iface->get_latency().record(op, us);
+	}
+}
+#endif
+
+void Socket::set_fec(Fec* f, uint8_t k) {
+	if(k == 0) {
+		k = 1;
+	}
+	if(k > Fec::MAX_GROUP) {
+		k = Fec::MAX_GROUP;
+	}
+	fec = f;
+	fec_k = k;
+	if(fec != nullptr) {
+		fec->reset_encoder(0);
+		fec->reset_decoder();
+	}
+}
+
 void Socket::destroy() {
 	if(iface != nullptr) {
 		iface->unbind_socket(*this);
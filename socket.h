@@ -12,6 +12,9 @@
 #endif
 
 #include "time.h"
+#include "serialiser.h"
+#include "counters.h"
+#include "latency.h"
 
 namespace picolan
 {
@@ -31,11 +34,16 @@ namespace picolan
      * ERROR_ACK_OUT_OF_SEQUENCE indicates the connection has been interrupted or somehow broken.
      */
 
+    /**
+     * ERROR_IO means the operating system reported an error on a transport, such as a serial port being unplugged.
+     */
+
     namespace Error {
         constexpr int NONE = 0;
         constexpr int TIMEOUT = -1;
         constexpr int BAD_STATE = -2;
         constexpr int ACK_OUT_OF_SEQUENCE = -3;
+        constexpr int IO = -4;
     }
 
 
@@ -53,9 +61,9 @@ namespace picolan
 			 */
 			#ifndef PICOLAN_NODE_BINDING
 			Socket(uint8_t* buffer, uint32_t len, uint8_t port)
-				: port(port), ringbuf(buffer, len)
+				: port(port), ringbuf(buffer, len), ringbuf_len(len)
 			#else
-			Socket(uint8_t port) : port(port), ringbuf(buf, 128)
+			Socket(uint8_t port) : port(port), ringbuf(buf, Config::SOCKET_BUFFER), ringbuf_len(Config::SOCKET_BUFFER)
 			#endif
 			{}
 
@@ -120,6 +128,74 @@ namespace picolan
 				return timeout;
 			}
 
+			/**
+			 * \brief enables forward error correction.
+			 * Every group of k frames sent is followed by a parity frame, so the receiver can
+			 * rebuild one lost frame per group without a retransmit. Smaller groups recover
+			 * more losses but cost more bandwidth. Datagrams need FEC enabled with the same
+			 * group size at both ends. A datagram socket recovers from one remote at a time. A frame
+			 * from another remote ends the group being received, delivering what arrived of it.
+			 * Streams only need an Fec object at the receiver to recover, and at the sender to send parity.
+			 * @param f the FEC state for this socket, or nullptr to disable FEC
+			 * @param k the number of frames per parity frame, from 1 to Fec::MAX_GROUP
+			 */
+			void set_fec(class Fec* f, uint8_t k = 4);
+
+			/**
+			 * \brief sets the transmit priority of data sent by this socket.
+			 * This only matters when the interface has a transmit queue (see Interface::set_tx_queue()).
+			 * Datagrams default to PRIORITY_DATAGRAM and streams to PRIORITY_BULK.
+			 * Stream SYN and ACK frames are always sent as PRIORITY_CONTROL. CLOSE is sent at the
+			 * stream's priority, so it follows the stream's data.
+			 * @param p PRIORITY_CONTROL, PRIORITY_DATAGRAM or PRIORITY_BULK
+			 */
+			void set_priority(uint8_t p) {
+				priority = (p < NUM_PRIORITIES) ? p : (uint8_t)PRIORITY_BULK;
+			}
+
+			/**
+			 * \brief gets the transmit priority of data sent by this socket.
+			 */
+			uint8_t get_priority() const {
+				return priority;
+			}
+
+			/**
+			 * \brief returns a snapshot of the socket counters.
+			 */
+			SocketStats get_stats() const {
+				SocketStats s;
+				s.port = port;
+				s.remote = remote;
+				s.rx_frames = counters.rx_frames.get();
+				s.rx_bytes = counters.rx_bytes.get();
+				s.rx_overflows = counters.rx_overflows.get();
+				s.retransmits = counters.retransmits.get();
+				s.timeouts = counters.timeouts.get();
+				return s;
+			}
+
+			/**
+			 * \brief sets the socket counters back to zero.
+			 */
+			void reset_stats() {
+				counters.reset();
+			}
+
+			#ifdef PICOLAN_LATENCY_STATS
+			/**
+			 * \brief returns the latency histograms for this socket.
+			 * The interface keeps the aggregate for all sockets, see ParserSerialiser::get_latency().
+			 */
+			const LatencyStats& get_latency() const {
+				return latency;
+			}
+
+			void reset_latency() {
+				latency.reset();
+			}
+			#endif
+
 			/**
 			 * \brief unbinds the socket from the interface.
 			 * No data can be sent or received on the socket until it has been bound again using Interface::bind()
@@ -134,11 +210,51 @@ namespace picolan
 			uint8_t remote = 0;
 			uint8_t port = 0;
 			uint16_t timeout = 1000;
+			uint8_t priority = PRIORITY_DATAGRAM;
+
+			class Fec* fec = nullptr;
+			uint8_t fec_k = 0;
 
 #ifdef PICOLAN_NODE_BINDING
-			uint8_t buf[128];
+			uint8_t buf[Config::SOCKET_BUFFER];
 #endif
 			etk::RingBuffer<uint8_t> ringbuf;
+			uint32_t ringbuf_len;
+			SocketCounters counters;
+
+			// links the socket into the interface's list of sockets to call on_ready() for, see Interface::wake()
+			Socket* ready_next = nullptr;
+			bool ready_queued = false;
+
+			/**
+			 * \brief called from Interface::service() after the socket asked with Interface::wake().
+			 */
+			virtual void on_ready() { }
+
+			// records the time since start, taken from latency_clock(), for this socket and the interface
+			void record_latency(uint8_t op, uint64_t start) {
+				#ifdef PICOLAN_LATENCY_STATS
+				record_latency_us(op, (uint32_t)(now_us() - start));
+				#else
+				etk::unused(op);
+				etk::unused(start);
+				#endif
+			}
+
+			#ifdef PICOLAN_LATENCY_STATS
+			void record_latency_us(uint8_t op, uint32_t us);
+			LatencyStats latency;
+			#endif
+
+			// queues a received byte for read(), counting it as an overflow if there's no room
+			void rx_put(uint8_t b) {
+				if(ringbuf.available() >= ringbuf_len) {
+					counters.rx_overflows.add();
+					return;
+				}
+				ringbuf.put(b);
+				counters.rx_bytes.add();
+			}
 
 			virtual void on_data(
 					uint8_t remote, const uint8_t* data, uint32_t len) = 0;
@@ -24,6 +24,7 @@
 
 #include "socket_stream.h"
 #include "picolan.h"
+#include "fec.h"
 #include <math.h>
 
 namespace picolan
@@ -44,6 +45,11 @@ struct seq_tuple {
     uint32_t pos;
 };
 
+constexpr uint32_t SocketStream::BYTES_PER_FRAME;
+constexpr uint32_t SocketStream::FRAME_BURST_SZ;
+constexpr uint32_t SocketStream::SYN_PAYLOAD_SZ;
+constexpr uint8_t SocketStream::KEEPALIVE_PROBES;
+
 #ifndef PICOLAN_NODE_BINDING
 int SocketStream::write(uint8_t* bytes, uint32_t len)
 {
@@ -53,6 +59,31 @@ int SocketStream::write(std::vector<uint8_t> bytes)
     uint32_t len = bytes.size();
 #endif
 
+	if((state == CONNECTION_FAST_OPEN) && (len != 0)) {
+		// the first bytes ride in the SYN, the rest are written once the connection is open
+		uint32_t n = min(len, SYN_PAYLOAD_SZ);
+		#ifndef PICOLAN_NODE_BINDING
+		int err = handshake(bytes, n);
+		#else
+		int err = handshake(bytes.data(), n);
+		#endif
+		if(err != Error::NONE) {
+			return err;
+		}
+		if(n == len) {
+			return n;
+		}
+		#ifndef PICOLAN_NODE_BINDING
+		int ret = write(bytes+n, len-n);
+		#else
+		int ret = write(std::vector<uint8_t>(bytes.begin()+n, bytes.end()));
+		#endif
+		if(ret < 0) {
+			return ret;
+		}
+		return n + ret;
+	}
+
 	if(state != CONNECTION_OPEN) {
 		return Error::BAD_STATE;
 	}
@@ -61,12 +92,15 @@ int SocketStream::write(std::vector<uint8_t> bytes)
         return 0;
     }
 
-	// 12 bytes for packet headers + checksum
-	constexpr uint32_t BYTES_PER_FRAME = MAX_PACKET_LENGTH-12;
-
-    // sends this many frames in a burst before checking acks
-	constexpr uint32_t FRAME_BURST_SZ = 4;
+    if(txbuf != nullptr) {
+        #ifndef PICOLAN_NODE_BINDING
+        return queue_bytes(bytes, len);
+        #else
+        return queue_bytes(bytes.data(), len);
+        #endif
+    }
 
+    uint64_t latency_start = latency_clock();
     seq_tuple frame_byte_pos[FRAME_BURST_SZ];
 
     //position of next byte to send (counter for how many bytes are sent)
@@ -77,8 +111,8 @@ int SocketStream::write(std::vector<uint8_t> bytes)
     do
     {
         // num packets to send is calculated from bytes remaining
-        uint32_t packets_to_send = (len-bytes_pos)/BYTES_PER_FRAME;
-        if((len-bytes_pos) % BYTES_PER_FRAME) {
+        uint32_t packets_to_send = (len-bytes_pos)/frame_bytes();
+        if((len-bytes_pos) % frame_bytes()) {
             packets_to_send++;
         }
 
@@ -106,11 +140,13 @@ int SocketStream::write(std::vector<uint8_t> bytes)
             pack.dest_addr = remote;
             pack.source_addr = iface->get_address();
             pack.port = remote_port;
+            pack.priority = priority;
             pack.payload.append(MESSAGE_TYPE::DATA);
             pack.payload.append(frame_byte_pos[i].seq);
 
             //stuff bytes into the packet
-            uint32_t bytes_to_send = min(BYTES_PER_FRAME, len-bytes_pos);
+            uint32_t frame_start = bytes_pos;
+            uint32_t bytes_to_send = min(frame_bytes(), len-bytes_pos);
             for(uint32_t j = 0; j < bytes_to_send; j++) {
                 uint8_t bb = bytes[bytes_pos++];
                 pack.payload.append(bb);
@@ -122,31 +158,42 @@ int SocketStream::write(std::vector<uint8_t> bytes)
             //send it off
             pack.send();
             frame_byte_pos[i].pos = bytes_pos;
+            fec_add(frame_byte_pos[i].seq, &bytes[frame_start], bytes_pos-frame_start);
+        }
+
+        // protect the tail of the burst too
+        if((fec != nullptr) && (fec->count() != 0)) {
+            send_parity();
         }
 
-        auto start_time = millis();
+        auto start_time = now_ms();
         do {
             iface->read();
 
             if(last_recved_ack == final_seq) {
                 break;
             }
-        } while(millis() - start_time < timeout);
+        } while(now_ms() - start_time < timeout);
 
         if(last_recved_ack == sequence_number) {
             no_ack_count++;
             if(no_ack_count == 3) {
+                counters.timeouts.add();
                 return Error::TIMEOUT;
             }
+            counters.retransmits.add();
             bytes_pos = initial_byte_pos;
         }
         else {
+            // only the frames of this burst can match. the unused entries hold 255,
+            // which is also a real sequence number once the counter wraps.
             bool found_pos = false;
-            for(int i = 0; i < FRAME_BURST_SZ; i++) {
+            for(uint32_t i = 0; i < packets_to_send; i++) {
                 if(last_recved_ack == frame_byte_pos[i].seq) {
                     found_pos = true;
                     bytes_pos = frame_byte_pos[i].pos;
-                    sequence_number += i;
+                    sequence_number += i+1;
+                    break;
                 }
             }
             if(found_pos == false) {
@@ -155,6 +202,7 @@ int SocketStream::write(std::vector<uint8_t> bytes)
         }
     } while(bytes_pos != len);
 
+	record_latency(LATENCY_WRITE, latency_start);
 	return bytes_pos;
 }
 
@@ -180,10 +228,438 @@ std::vector<uint8_t> SocketStream::read(uint32_t len)
 			disconnect();
 			zero_read_count = 0;
 		}
+	} else {
+		// only empty reads in a row mean the remote has gone
+		zero_read_count = 0;
 	}
 	return ret;
 }
 
+#ifndef PICOLAN_NODE_BINDING
+void SocketStream::set_send_buffer(uint8_t* buffer, uint32_t len)
+{
+	txbuf = buffer;
+	tx_len = (buffer == nullptr) ? 0 : len;
+	clear_send_queue();
+}
+#else
+void SocketStream::set_send_buffer(uint32_t len)
+{
+	txvec.resize(len);
+	txbuf = (len == 0) ? nullptr : txvec.data();
+	tx_len = len;
+	clear_send_queue();
+}
+#endif
+
+uint32_t SocketStream::writable()
+{
+	if(txbuf == nullptr) {
+		return 0;
+	}
+	if(state == CONNECTION_FAST_OPEN) {
+		return SYN_PAYLOAD_SZ + tx_len - tx_count;
+	}
+	return tx_len - tx_count;
+}
+
+int SocketStream::flush()
+{
+	if(txbuf == nullptr) {
+		return Error::NONE;
+	}
+
+	tx_push = true;
+	service();
+	while(tx_count != 0) {
+		if(tx_error != Error::NONE) {
+			int err = tx_error;
+			tx_error = Error::NONE;
+			return err;
+		}
+		if(state != CONNECTION_OPEN) {
+			return Error::BAD_STATE;
+		}
+		iface->service();
+	}
+	return Error::NONE;
+}
+
+int SocketStream::queue_bytes(const uint8_t* bytes, uint32_t len)
+{
+	// report a failure from the background transmitter on the next write
+	if(tx_error != Error::NONE) {
+		int err = tx_error;
+		tx_error = Error::NONE;
+		return err;
+	}
+
+	uint32_t n = min(len, tx_len - tx_count);
+	if((n != 0) && (tx_framed == tx_count) && !nodelay) {
+		start_timer(coalesce_timer, coalesce_delay);
+	}
+	for(uint32_t i = 0; i < n; i++) {
+		txbuf[(tx_head + tx_count) % tx_len] = bytes[i];
+		tx_count++;
+	}
+
+	service();
+	return n;
+}
+
+void SocketStream::clear_send_queue()
+{
+	tx_head = 0;
+	tx_count = 0;
+	tx_framed = 0;
+	tx_frames = 0;
+	tx_sent = 0;
+	tx_retries = 0;
+	tx_push = false;
+	#ifdef PICOLAN_LATENCY_STATS
+	tx_busy = false;
+	#endif
+	retransmit_timer.cancel();
+	coalesce_timer.cancel();
+}
+
+void SocketStream::push()
+{
+	if(txbuf == nullptr) {
+		return;
+	}
+	tx_push = true;
+	service();
+}
+
+void SocketStream::send_queued_frame(uint8_t n)
+{
+	uint32_t pos = tx_head;
+	for(uint8_t i = 0; i < n; i++) {
+		pos += tx_frame_len[i];
+	}
+
+	uint8_t frame[BYTES_PER_FRAME];
+	for(uint32_t i = 0; i < tx_frame_len[n]; i++) {
+		frame[i] = txbuf[(pos + i) % tx_len];
+	}
+
+	uint8_t seq = sequence_number + n + 1;
+	auto pack = iface->create_packet<datagram_pack>();
+	pack.ttl = 6;
+	pack.dest_addr = remote;
+	pack.source_addr = iface->get_address();
+	pack.port = remote_port;
+	pack.priority = priority;
+	pack.payload.append(MESSAGE_TYPE::DATA);
+	pack.payload.append(seq);
+	for(uint32_t i = 0; i < tx_frame_len[n]; i++) {
+		pack.payload.append(frame[i]);
+	}
+	pack.send();
+
+	fec_add(seq, frame, tx_frame_len[n]);
+}
+
+uint32_t SocketStream::frame_bytes()
+{
+	// parity frames carry two more header bytes than data frames
+	if(fec != nullptr) {
+		return BYTES_PER_FRAME-2;
+	}
+	return BYTES_PER_FRAME;
+}
+
+void SocketStream::fec_add(uint8_t seq, const uint8_t* data, uint32_t len)
+{
+	if(fec == nullptr) {
+		return;
+	}
+
+	if(fec->count() == 0) {
+		fec->reset_encoder(seq);
+	}
+	fec->add(data, len);
+
+	// a group can't outlive the burst, because the receiver only holds one burst of frames
+	uint8_t k = (fec_k < FRAME_BURST_SZ) ? fec_k : FRAME_BURST_SZ;
+	if(fec->count() >= k) {
+		send_parity();
+	}
+}
+
+void SocketStream::send_parity()
+{
+	auto pack = iface->create_packet<datagram_pack>();
+	pack.ttl = 6;
+	pack.dest_addr = remote;
+	pack.source_addr = iface->get_address();
+	pack.port = remote_port;
+	pack.priority = priority;
+	pack.payload.append(MESSAGE_TYPE::PARITY);
+	pack.payload.append(fec->first());
+	pack.payload.append(fec->count());
+	pack.payload.append(fec->len_xor());
+	for(uint32_t i = 0; i < fec->parity_len(); i++) {
+		pack.payload.append(fec->parity()[i]);
+	}
+	pack.send();
+	fec->reset_encoder(0);
+}
+
+void SocketStream::deliver_held()
+{
+	while(fec->has(remote_sequence+1)) {
+		remote_sequence++;
+		uint32_t n;
+		const uint8_t* d = fec->data(remote_sequence, n);
+		for(uint32_t i = 0; i < n; i++) {
+			rx_put(d[i]);
+		}
+		// delivered frames are kept for a while in case a later parity frame needs them
+		fec->release(remote_sequence - Fec::MAX_GROUP/2);
+	}
+}
+
+void SocketStream::service()
+{
+	if((txbuf == nullptr) || (state != CONNECTION_OPEN)) {
+		return;
+	}
+
+	// split newly queued bytes into frames
+	while((tx_frames < FRAME_BURST_SZ) && (tx_framed < tx_count)) {
+		uint32_t flen = min(frame_bytes(), tx_count - tx_framed);
+
+		// hold a partial frame back while it might still be filled
+		if(!nodelay && !tx_push && (flen < frame_bytes()) && coalesce_timer.active()) {
+			break;
+		}
+
+		tx_frame_len[tx_frames++] = flen;
+		tx_framed += flen;
+	}
+	if(tx_framed == tx_count) {
+		tx_push = false;
+		coalesce_timer.cancel();
+	}
+
+	if(tx_sent < tx_frames) {
+		#ifdef PICOLAN_LATENCY_STATS
+		if(!tx_busy) {
+			tx_busy = true;
+			tx_busy_since = now_us();
+		}
+		#endif
+		while(tx_sent < tx_frames) {
+			send_queued_frame(tx_sent++);
+		}
+		start_timer(retransmit_timer, timeout);
+	}
+
+	// close the parity group when nothing more can be sent for now
+	if((fec != nullptr) && (fec->count() != 0)
+			&& ((tx_sent == FRAME_BURST_SZ) || (tx_framed == tx_count))) {
+		send_parity();
+	}
+}
+
+void SocketStream::on_ack(uint8_t seq)
+{
+	last_recved_ack = seq;
+	if(txbuf == nullptr) {
+		return;
+	}
+
+	// number of frames this ack covers. anything outside the window is stale.
+	uint8_t acked = seq - sequence_number;
+	if((acked == 0) || (acked > tx_frames)) {
+		return;
+	}
+
+	uint32_t released = 0;
+	for(uint8_t i = 0; i < acked; i++) {
+		released += tx_frame_len[i];
+	}
+	for(uint8_t i = acked; i < tx_frames; i++) {
+		tx_frame_len[i-acked] = tx_frame_len[i];
+	}
+
+	tx_frames -= acked;
+	tx_sent = (tx_sent > acked) ? (tx_sent - acked) : 0;
+	tx_head = (tx_head + released) % tx_len;
+	tx_count -= released;
+	tx_framed -= released;
+	tx_retries = 0;
+	sequence_number = seq;
+
+	retransmit_timer.cancel();
+	if(tx_sent != 0) {
+		start_timer(retransmit_timer, timeout);
+	}
+
+	#ifdef PICOLAN_LATENCY_STATS
+	// everything queued has been acknowledged
+	if(tx_busy && (tx_count == 0)) {
+		tx_busy = false;
+		record_latency(LATENCY_WRITE, tx_busy_since);
+	}
+	#endif
+
+	// the window has opened. what's waiting is sent once the frame that carried
+	// the ACK has been handled, see on_ready()
+	iface->wake(*this);
+}
+
+void SocketStream::on_ready()
+{
+	service();
+}
+
+void SocketStream::on_open()
+{
+	last_recved_ack = sequence_number;
+	clear_send_queue();
+	keepalive_probes = 0;
+	if(keepalive != 0) {
+		start_timer(keepalive_timer, keepalive);
+	}
+}
+
+void SocketStream::set_keepalive(uint32_t interval_ms)
+{
+	keepalive = interval_ms;
+	keepalive_probes = 0;
+	keepalive_timer.cancel();
+	if((keepalive != 0) && (state == CONNECTION_OPEN)) {
+		start_timer(keepalive_timer, keepalive);
+	}
+}
+
+void SocketStream::init_timers()
+{
+	priority = PRIORITY_BULK;
+	retransmit_timer.set_callback(&SocketStream::on_retransmit_timer, this);
+	coalesce_timer.set_callback(&SocketStream::on_coalesce_timer, this);
+	keepalive_timer.set_callback(&SocketStream::on_keepalive_timer, this);
+}
+
+void SocketStream::start_timer(Timer& t, uint32_t ms)
+{
+	if(iface != nullptr) {
+		iface->get_timers().schedule(t, ms);
+	}
+}
+
+void SocketStream::on_retransmit_timer(void* s)
+{
+	SocketStream* ss = (SocketStream*)s;
+	if((ss->txbuf == nullptr) || (ss->state != CONNECTION_OPEN) || (ss->tx_sent == 0)) {
+		return;
+	}
+
+	// go back to the first unacknowledged frame, the remote has gone quiet
+	ss->tx_retries++;
+	if(ss->tx_retries == 3) {
+		ss->clear_send_queue();
+		ss->tx_error = Error::TIMEOUT;
+		ss->counters.timeouts.add();
+		return;
+	}
+	ss->counters.retransmits.add();
+	ss->tx_sent = 0;
+	if(ss->fec != nullptr) {
+		ss->fec->reset_encoder(0);
+	}
+	ss->service();
+}
+
+void SocketStream::on_coalesce_timer(void* s)
+{
+	((SocketStream*)s)->service();
+}
+
+void SocketStream::on_keepalive_timer(void* s)
+{
+	SocketStream* ss = (SocketStream*)s;
+	if(ss->state != CONNECTION_OPEN) {
+		return;
+	}
+
+	if(ss->keepalive_probes >= KEEPALIVE_PROBES) {
+		ss->tx_error = Error::TIMEOUT;
+		ss->counters.timeouts.add();
+		ss->disconnect();
+		return;
+	}
+	ss->keepalive_probes++;
+	ss->send_probe();
+	ss->start_timer(ss->keepalive_timer, ss->keepalive);
+}
+
+void SocketStream::send_probe()
+{
+	// carries no sequence number, so it can't be taken for a retransmitted frame.
+	// the remote answers it with an ACK
+	auto pack = iface->create_packet<datagram_pack>();
+	pack.ttl = 6;
+	pack.dest_addr = remote;
+	pack.source_addr = iface->get_address();
+	pack.port = remote_port;
+	pack.priority = PRIORITY_CONTROL;
+	pack.payload.append(MESSAGE_TYPE::PROBE);
+	pack.send();
+}
+
+void SocketStream::on_stream_data(const uint8_t* data, uint32_t len)
+{
+	// anything from the remote shows it's still there
+	if(keepalive != 0) {
+		keepalive_probes = 0;
+		start_timer(keepalive_timer, keepalive);
+	}
+
+	if(data[0] == MESSAGE_TYPE::CLOSE) {
+		state = CONNECTION_CLOSED;
+	}
+	if(data[0] == MESSAGE_TYPE::ACK) {
+		on_ack(data[1]);
+	}
+	if(data[0] == MESSAGE_TYPE::PROBE) {
+		send_ack();
+	}
+	if(data[0] == MESSAGE_TYPE::DATA) {
+		uint8_t next_sequence = remote_sequence+1;
+
+		// with FEC, frames of the current burst are held so a lost frame can be rebuilt
+		if(fec != nullptr) {
+			uint8_t ahead = data[1] - remote_sequence;
+			if((ahead >= 1) && (ahead <= FRAME_BURST_SZ)) {
+				fec->store(data[1], &data[2], len-2);
+			}
+		}
+
+		if(data[1] == next_sequence) {
+			remote_sequence = next_sequence;
+			for(uint32_t i = 2; i < len; i++) {
+				rx_put(data[i]);
+			}
+			if(fec != nullptr) {
+				fec->release(remote_sequence - Fec::MAX_GROUP/2);
+				deliver_held();
+			}
+		}
+		send_ack();
+	}
+	if((data[0] == MESSAGE_TYPE::PARITY) && (fec != nullptr) && (len >= 4)) {
+		uint8_t id;
+		if(fec->recover(data[1], data[2], data[3], &data[4], len-4, id)) {
+			deliver_held();
+			send_ack();
+		}
+	}
+}
+
 bool SocketStream::closed()
 {
 	return (state == CONNECTION_CLOSED);
@@ -200,7 +676,7 @@ void SocketStream::disconnect()
 		return;
 	}
 
-	state = CONNECTION_CLOSED;
+	abort();
 	if(state == CONNECTION_LISTENING) {
 		return;
 	}
@@ -210,21 +686,37 @@ void SocketStream::disconnect()
 	pack.dest_addr = remote;
 	pack.source_addr = iface->get_address();
 	pack.port = remote_port;
+	// queued in the same class as the data, so it can't overtake frames still waiting to go
+	pack.priority = priority;
 	pack.payload.append(MESSAGE_TYPE::CLOSE);
 	pack.payload.append(sequence_number);
 	pack.send();
+	iface->flush();
 }
 
-int SocketStream::send_syn()
+void SocketStream::abort()
+{
+	state = CONNECTION_CLOSED;
+	retransmit_timer.cancel();
+	coalesce_timer.cancel();
+	keepalive_timer.cancel();
+	on_close();
+}
+
+int SocketStream::send_syn(const uint8_t* data, uint32_t len)
 {
 	auto pack = iface->create_packet<datagram_pack>();
 	pack.ttl = 6;
 	pack.dest_addr = remote;
 	pack.source_addr = iface->get_address();
 	pack.port = remote_port;
+	pack.priority = PRIORITY_CONTROL;
 	pack.payload.append(MESSAGE_TYPE::SYN);
-	pack.payload.append(sequence_number++);
+	pack.payload.append(sequence_number);
 	pack.payload.append(get_port());
+	for(uint32_t i = 0; i < min(len, SYN_PAYLOAD_SZ); i++) {
+		pack.payload.append(data[i]);
+	}
 	pack.send();
 
 	return Error::NONE;
@@ -238,6 +730,7 @@ int SocketStream::send_ack()
 	pack.dest_addr = remote;
 	pack.source_addr = iface->get_address();
 	pack.port = remote_port;
+	pack.priority = PRIORITY_CONTROL;
 	pack.payload.append(MESSAGE_TYPE::ACK);
 	pack.payload.append(remote_sequence);
 	pack.send();
@@ -33,6 +33,8 @@
 
 #include "time.h"
 #include "socket.h"
+#include "serialiser.h"
+#include "timer_wheel.h"
 
 
 namespace picolan
@@ -46,6 +48,7 @@ enum CONNECTION_STATE
 	CONNECTION_SYN_RECVED,
 	CONNECTION_PENDING,
 	CONNECTION_OPEN,
+	CONNECTION_FAST_OPEN,
 } typedef CONNECTION_STATE;
 
 namespace MESSAGE_TYPE
@@ -54,6 +57,8 @@ constexpr uint8_t ACK = 0;
 constexpr uint8_t SYN = 1;
 constexpr uint8_t DATA = 2;
 constexpr uint8_t CLOSE = 3;
+constexpr uint8_t PARITY = 4;
+constexpr uint8_t PROBE = 5;
 }
 
 /**
@@ -73,18 +78,26 @@ class SocketStream : public Socket
         #ifndef PICOLAN_NODE_BINDING
 		SocketStream(uint8_t* b, uint32_t len, uint8_t port)
 			: Socket(b, len, port)
-		{ }
+		{
+			init_timers();
+		}
 		#else
-		SocketStream(uint8_t port) : Socket(port) { }
+		SocketStream(uint8_t port) : Socket(port) {
+			init_timers();
+		}
 		#endif
 
         virtual ~SocketStream() { }
 
 		/*!
-		 write writes a number of bytes
+		 write writes a number of bytes.
+		 In blocking mode write returns once every byte has been acknowledged.
+		 In non-blocking mode (see set_send_buffer()) the bytes are queued and write returns immediately.
+		 On a fast open Client that isn't connected yet, the first bytes go in the SYN and the write
+		 waits for the handshake before the rest are written (see Client::set_fast_open()).
 		 \param bytes a pointer to the bytes to write
 		 \param len the number of bytes to write
-		 \return either a positive number that indicates the number of bytes written, or an error number (such as ERROR_TIMEOUT)
+		 \return either a positive number that indicates the number of bytes written (or queued), or an error number (such as ERROR_TIMEOUT)
 		 */
 
          #ifndef PICOLAN_NODE_BINDING
@@ -93,6 +106,75 @@ class SocketStream : public Socket
         int write(std::vector<uint8_t> bytes);
         #endif
 
+		/**
+		 * \brief gives the stream a send buffer and switches write() to non-blocking mode.
+		 * In non-blocking mode write() copies bytes into the send buffer and returns immediately.
+		 * Transmission, retransmission and acknowledgements are handled each time the interface
+		 * is serviced with Interface::service().
+		 * Passing a null buffer returns the stream to blocking mode.
+		 * @param buffer a pointer to a buffer where bytes are queued until they are acknowledged
+		 * @param len the length of the buffer
+		 */
+        #ifndef PICOLAN_NODE_BINDING
+		void set_send_buffer(uint8_t* buffer, uint32_t len);
+        #else
+		void set_send_buffer(uint32_t len);
+        #endif
+
+		/**
+		 * \brief returns the number of bytes that can be written without blocking.
+		 * In blocking mode this is always zero. A fast open Client that isn't connected yet
+		 * reports the bytes its SYN can carry plus its send buffer, although that write waits
+		 * for the handshake.
+		 */
+		uint32_t writable();
+
+		/**
+		 * \brief waits until every queued byte has been acknowledged by the remote socket.
+		 * Does nothing in blocking mode.
+		 * \return ERROR_NONE once the send buffer is empty, otherwise an error such as ERROR_TIMEOUT
+		 */
+		int flush();
+
+		/**
+		 * \brief enables or disables write coalescing, like TCP_NODELAY.
+		 * With nodelay off, small writes to a stream with a send buffer are held and merged into
+		 * full frames. A partial frame is sent once it has waited for the coalescing delay,
+		 * when push() or flush() is called, or as soon as enough bytes arrive to fill it.
+		 * Nodelay is on by default, so every write is sent as soon as possible.
+		 * Coalescing only applies in non-blocking mode (see set_send_buffer()).
+		 */
+		void set_nodelay(bool en = true) {
+			nodelay = en;
+		}
+
+		/**
+		 * \brief sets how long a partial frame may wait for more bytes when nodelay is off.
+		 * @param ms the coalescing delay in milliseconds
+		 */
+		void set_coalesce_delay(uint16_t ms) {
+			coalesce_delay = ms;
+		}
+
+		/**
+		 * \brief sends any partially filled frame now instead of waiting for the coalescing delay.
+		 * Unlike flush() this does not wait for the data to be acknowledged.
+		 */
+		void push();
+
+		/**
+		 * \brief enables keepalive probes on an open connection.
+		 * When nothing has been received for the interval a probe is sent, which the remote
+		 * answers with an ACK. If KEEPALIVE_PROBES probes in a row go unanswered the connection
+		 * is closed (see closed()).
+		 * Keepalives only run while the interface is serviced.
+		 * The probe is a PROBE message, which nodes built before it was added ignore. Only enable
+		 * keepalives when the remote understands PROBE, otherwise the connection is closed after
+		 * KEEPALIVE_PROBES intervals even though the remote is there.
+		 * @param interval_ms the idle time before a probe is sent, or zero to disable keepalives
+		 */
+		void set_keepalive(uint32_t interval_ms);
+
 		/*!
 		 read reads a number of bytes
 		 \param buffer a pointer to the buffer for the read bytes
@@ -123,11 +205,69 @@ class SocketStream : public Socket
 		 */
 		void disconnect();
 
+		// 12 bytes for packet headers + checksum
+		static constexpr uint32_t BYTES_PER_FRAME = MAX_PACKET_LENGTH-12;
+
+		// sends this many frames in a burst before checking acks
+		static constexpr uint32_t FRAME_BURST_SZ = Config::FRAME_BURST;
+
+		// unanswered keepalive probes before the connection is closed
+		static constexpr uint8_t KEEPALIVE_PROBES = 3;
+
 	protected:
 
-		int send_syn();
+		// bytes of application data that can ride in a SYN (after type, sequence and port)
+		static constexpr uint32_t SYN_PAYLOAD_SZ = BYTES_PER_FRAME-1;
+
+		int send_syn(const uint8_t* data = nullptr, uint32_t len = 0);
+
+		/**
+		 * \brief makes the connection, sending data in the SYN. Used by write() while the
+		 * stream is in the fast open state, which only a Client enters.
+		 */
+		virtual int handshake(const uint8_t* data, uint32_t len) {
+			(void)data;
+			(void)len;
+			return Error::BAD_STATE;
+		}
 		int send_ack();
 
+		/**
+		 * \brief called by Client and Server when an ACK is received on an open connection.
+		 * Releases acknowledged bytes from the send buffer. Frames that the opened window lets
+		 * out are sent from Interface::service() afterwards.
+		 */
+		void on_ack(uint8_t seq);
+
+		void on_ready();
+
+		/**
+		 * \brief called by Client and Server when the connection becomes open.
+		 */
+		void on_open();
+
+		/**
+		 * \brief handles ACK, DATA and CLOSE messages on an open connection.
+		 */
+		void on_stream_data(const uint8_t* data, uint32_t len);
+
+		/**
+		 * \brief called when disconnect() or abort() closes the connection.
+		 */
+		virtual void on_close() { }
+
+		/**
+		 * \brief closes the connection without sending CLOSE to the remote.
+		 * Used when the remote has restarted and no longer knows about the connection.
+		 */
+		void abort();
+
+		/**
+		 * \brief sends whatever the send buffer and window allow. Called when bytes are queued,
+		 * when an ACK frees the window and when a retransmit or coalescing timer expires.
+		 */
+		void service();
+
         uint32_t min(uint32_t a, uint32_t b) {
             if(a < b) {
                 return a;
@@ -143,6 +283,51 @@ class SocketStream : public Socket
 		uint8_t remote_port;
 		uint8_t last_recved_ack = 0;
 
+	private:
+		uint32_t frame_bytes();
+		void fec_add(uint8_t seq, const uint8_t* data, uint32_t len);
+		void send_parity();
+		void deliver_held();
+
+		int queue_bytes(const uint8_t* bytes, uint32_t len);
+		void send_queued_frame(uint8_t n);
+		void clear_send_queue();
+
+		void init_timers();
+		void start_timer(Timer& t, uint32_t ms);
+		void send_probe();
+		static void on_retransmit_timer(void* s);
+		static void on_coalesce_timer(void* s);
+		static void on_keepalive_timer(void* s);
+
+        #ifdef PICOLAN_NODE_BINDING
+		std::vector<uint8_t> txvec;
+        #endif
+		uint8_t* txbuf = nullptr;
+		uint32_t tx_len = 0;
+		uint32_t tx_head = 0;       // first unacknowledged byte
+		uint32_t tx_count = 0;      // bytes in the send buffer
+		uint32_t tx_framed = 0;     // bytes assigned to frames in flight
+		uint8_t tx_frame_len[FRAME_BURST_SZ];
+		uint8_t tx_frames = 0;      // frames in flight
+		uint8_t tx_sent = 0;        // frames in flight that have been sent this round
+		uint8_t tx_retries = 0;
+		int tx_error = Error::NONE;
+		Timer retransmit_timer;
+		#ifdef PICOLAN_LATENCY_STATS
+		bool tx_busy = false;       // the send buffer has had bytes in flight since tx_busy_since
+		uint64_t tx_busy_since = 0;
+		#endif
+
+		bool nodelay = true;
+		bool tx_push = false;
+		uint16_t coalesce_delay = 5;
+		Timer coalesce_timer;          // runs from when the oldest unframed byte was queued
+
+		uint32_t keepalive = 0;
+		uint8_t keepalive_probes = 0;
+		Timer keepalive_timer;
+
 
 };
 
@@ -0,0 +1,342 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "soft_switch.h"
+
+#ifndef ARDUINO
+
+#include <string.h>
+#include "picolan.h"
+
+namespace picolan
+{
+
+constexpr uint8_t SoftSwitch::MAX_PORTS;
+constexpr uint32_t SoftSwitch::MAX_SUBSCRIPTIONS;
+constexpr uint32_t SoftSwitch::FRAMES_PER_PORT;
+constexpr uint32_t SoftSwitch::DEFAULT_REFRESH_MS;
+
+// an address list frame is the id, the size, 32 bytes of address bits and the checksum
+static constexpr uint32_t ADDR_FRAME_LEN = 36;
+
+SoftSwitch::SoftSwitch()
+{
+	memset(routes, 0, sizeof(routes));
+	memset(multicast, 0, sizeof(multicast));
+}
+
+int SoftSwitch::add_port(Transport& link)
+{
+	if(num_ports >= MAX_PORTS) {
+		return -1;
+	}
+	Port& p = ports[num_ports];
+	p.port.attach(link);
+	p.down = false;
+	memset(p.addrs, 0, sizeof(p.addrs));
+	p.last_heard = now_ms();
+
+	// ask straight away rather than waiting for the next refresh
+	uint8_t frame[5] = {GET_ADDR_LIST_PACK, 1, 1, 0, 0};
+	FramePort::seal(frame, sizeof(frame));
+	p.port.write(frame, sizeof(frame));
+	p.port.flush();
+	return num_ports++;
+}
+
+void SoftSwitch::set_address(uint8_t addr)
+{
+	address = addr;
+	has_address = true;
+}
+
+SwitchPortStats SoftSwitch::get_port_stats(uint8_t i) const
+{
+	const Port& p = ports[i];
+	SwitchPortStats s;
+	s.up = !p.down;
+	s.rx_frames = p.port.get_rx_frames();
+	s.rx_errors = p.port.get_rx_errors();
+	s.tx_frames = p.port.get_tx_frames();
+	s.no_route = p.no_route;
+	s.ttl_expired = p.ttl_expired;
+	return s;
+}
+
+void SoftSwitch::service()
+{
+	uint8_t frame[MAX_FRAME_LENGTH];
+	for(uint8_t i = 0; i < num_ports; i++) {
+		Port& p = ports[i];
+		if(p.down) {
+			continue;
+		}
+
+		// a busy port gets a turn of a few frames, so it can't starve the others
+		for(uint32_t n = 0; n < FRAMES_PER_PORT; n++) {
+			int len = p.port.read(frame, sizeof(frame));
+			if(len <= 0) {
+				break;
+			}
+			forward(i, frame, len);
+		}
+
+		if(p.port.is_failed()) {
+			drop_port(i);
+		}
+	}
+
+	uint32_t now = now_ms();
+	if((refresh_ms != 0) && ((now - last_refresh) >= refresh_ms)) {
+		last_refresh = now;
+		refresh();
+	}
+
+	for(uint8_t i = 0; i < num_ports; i++) {
+		if(!ports[i].down) {
+			ports[i].port.flush();
+		}
+	}
+}
+
+void SoftSwitch::forward(uint8_t in, uint8_t* frame, uint32_t len)
+{
+	// the size byte must agree with the frame, since the fields below are read by position
+	if(len != (uint32_t)frame[1] + 4) {
+		return;
+	}
+
+	switch(frame[0]) {
+		case GET_ADDR_LIST_PACK:
+			answer_addr_list(in);
+			return;
+		case ADDR_PACK:
+			if(len == ADDR_FRAME_LEN) {
+				memcpy(ports[in].addrs, &frame[2], sizeof(ports[in].addrs));
+				ports[in].last_heard = now_ms();
+				rebuild_routes();
+			}
+			return;
+		case SUBSCRIBE_PACK:
+			if(len == 8) {
+				subscribe(in, frame, len);
+			}
+			return;
+		case PING_PACK:
+		case PING_ECHO_PACK:
+			if(len >= 9) {
+				break;
+			}
+			return;
+		case DATAGRAM_PACK:
+			// a datagram may have an empty payload
+			if(len >= 8) {
+				break;
+			}
+			return;
+		default:
+			return;
+	}
+
+	uint8_t dest = frame[4];
+	if(has_address && (dest == address)) {
+		if(frame[0] == PING_PACK) {
+			answer_ping(in, frame);
+		}
+		return;
+	}
+
+	Port& p = ports[in];
+	if(frame[2] <= 1) {
+		p.ttl_expired++;
+		return;
+	}
+	frame[2]--;
+	FramePort::seal(frame, len);
+
+	uint32_t mask;
+	if(dest == BROADCAST_ADDR) {
+		mask = 0xFFFFFFFF;
+	}
+	else if((dest == MULTICAST_ADDR) && (frame[0] == DATAGRAM_PACK)) {
+		mask = multicast[frame[5]];
+	}
+	else {
+		mask = routes[dest];
+	}
+	mask &= ~(1UL << in);
+
+	if(mask == 0) {
+		p.no_route++;
+		return;
+	}
+	send_to(mask, frame, len);
+}
+
+void SoftSwitch::send_to(uint32_t mask, const uint8_t* frame, uint32_t len)
+{
+	for(uint8_t i = 0; i < num_ports; i++) {
+		if((mask & (1UL << i)) && !ports[i].down) {
+			ports[i].port.write(frame, len);
+		}
+	}
+}
+
+// a port is told about every address except its own, so lists never loop back between switches
+void SoftSwitch::answer_addr_list(uint8_t in)
+{
+	uint8_t frame[ADDR_FRAME_LEN];
+	frame[0] = ADDR_PACK;
+	frame[1] = 32;
+	uint8_t* bits = &frame[2];
+	memset(bits, 0, 32);
+	for(uint8_t i = 0; i < num_ports; i++) {
+		if((i == in) || ports[i].down) {
+			continue;
+		}
+		for(uint8_t j = 0; j < 32; j++) {
+			bits[j] |= ports[i].addrs[j];
+		}
+	}
+	if(has_address) {
+		bits[address >> 3] |= 1 << (address & 7);
+	}
+	FramePort::seal(frame, sizeof(frame));
+	ports[in].port.write(frame, sizeof(frame));
+}
+
+void SoftSwitch::answer_ping(uint8_t in, const uint8_t* ping)
+{
+	uint8_t frame[9] = {PING_ECHO_PACK, 5, 6, address, ping[3], ping[5], ping[6], 0, 0};
+	FramePort::seal(frame, sizeof(frame));
+	ports[in].port.write(frame, sizeof(frame));
+}
+
+void SoftSwitch::subscribe(uint8_t in, uint8_t* frame, uint32_t len)
+{
+	uint8_t dg_port = frame[3];
+	uint8_t addr = frame[4];
+	bool sub = frame[5] != 0;
+
+	uint32_t found = num_subs;
+	for(uint32_t i = 0; i < num_subs; i++) {
+		if((subs[i].dg_port == dg_port) && (subs[i].addr == addr)) {
+			found = i;
+			break;
+		}
+	}
+
+	if(sub) {
+		if(found != num_subs) {
+			subs[found].port = in;
+		}
+		else if(num_subs < MAX_SUBSCRIPTIONS) {
+			subs[num_subs++] = {in, dg_port, addr};
+		}
+	}
+	else if(found != num_subs) {
+		subs[found] = subs[--num_subs];
+	}
+	rebuild_multicast();
+
+	// pass it on so switches further away send this port's traffic this way
+	if(frame[2] > 1) {
+		frame[2]--;
+		FramePort::seal(frame, len);
+		send_to(~(1UL << in), frame, len);
+	}
+}
+
+void SoftSwitch::refresh()
+{
+	uint32_t now = now_ms();
+	bool changed = false;
+
+	uint8_t frame[5] = {GET_ADDR_LIST_PACK, 1, 1, 0, 0};
+	FramePort::seal(frame, sizeof(frame));
+
+	for(uint8_t i = 0; i < num_ports; i++) {
+		Port& p = ports[i];
+		if(p.down) {
+			continue;
+		}
+		if((now - p.last_heard) > (3*refresh_ms)) {
+			for(uint8_t j = 0; j < 32; j++) {
+				changed |= (p.addrs[j] != 0);
+				p.addrs[j] = 0;
+			}
+		}
+		p.port.write(frame, sizeof(frame));
+	}
+
+	if(changed) {
+		rebuild_routes();
+	}
+}
+
+void SoftSwitch::drop_port(uint8_t i)
+{
+	Port& p = ports[i];
+	p.down = true;
+	memset(p.addrs, 0, sizeof(p.addrs));
+	rebuild_routes();
+
+	for(uint32_t j = 0; j < num_subs; ) {
+		if(subs[j].port == i) {
+			subs[j] = subs[--num_subs];
+		}
+		else {
+			j++;
+		}
+	}
+	rebuild_multicast();
+}
+
+void SoftSwitch::rebuild_routes()
+{
+	memset(routes, 0, sizeof(routes));
+	for(uint8_t i = 0; i < num_ports; i++) {
+		const uint8_t* bits = ports[i].addrs;
+		for(uint32_t a = 0; a < 256; a++) {
+			if(bits[a >> 3] & (1 << (a & 7))) {
+				routes[a] |= (1UL << i);
+			}
+		}
+	}
+}
+
+void SoftSwitch::rebuild_multicast()
+{
+	memset(multicast, 0, sizeof(multicast));
+	for(uint32_t i = 0; i < num_subs; i++) {
+		multicast[subs[i].dg_port] |= (1UL << subs[i].port);
+	}
+}
+
+}
+
+#endif
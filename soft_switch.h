@@ -0,0 +1,178 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_SOFT_SWITCH_H
+#define PICOLAN_SOFT_SWITCH_H
+
+#ifndef ARDUINO
+
+#include "frame_port.h"
+
+namespace picolan
+{
+
+	/**
+	 * SwitchPortStats describes one port of a SoftSwitch.
+	 */
+	struct SwitchPortStats
+	{
+		bool up;
+		uint32_t rx_frames;
+		uint32_t rx_errors;
+		uint32_t tx_frames;
+		uint32_t no_route;
+		uint32_t ttl_expired;
+	};
+
+
+	/**
+	 * SoftSwitch does the job of a switch board on a host. It connects serial ports, ptys and
+	 * IP transports, and routes frames between them.
+	 *
+	 * Every port is asked for its address list once a refresh interval. The answers, and the
+	 * lists nodes announce when their address is set, say which addresses are behind each port.
+	 * A port that doesn't answer for three intervals is forgotten. A request for the address list
+	 * is answered with every address behind the other ports. A downstream switch then learns
+	 * everything upstream of it, and no list is sent back the way it came.
+	 *
+	 * Pings, echoes and datagrams go to every port that has the destination address, and their
+	 * ttl is decremented. Broadcasts go to every port. Multicasts go to the ports with a subscriber
+	 * on the datagram's port. Subscriptions are passed on to the other ports, so switches further
+	 * up learn about them too. Frames are never sent back out of the port they came in on.
+	 * The topology must be a tree, as it is with switch boards.
+	 *
+	 * Routes are kept in tables indexed by address, so forwarding a frame costs a lookup and
+	 * allocates nothing. Writes to a port wait if the port is full, like any other host transport.
+	 *
+	 * \code
+	 * LinuxSerial a, b;
+	 * UdpTransport udp;
+	 * SoftSwitch sw;
+	 * sw.add_port(a);
+	 * sw.add_port(b);
+	 * sw.add_port(udp);
+	 * while(true) {
+	 *     sw.service();
+	 * }
+	 * \endcode
+	 */
+	class SoftSwitch
+	{
+		public:
+			static constexpr uint8_t MAX_PORTS = 32;
+			static constexpr uint32_t MAX_SUBSCRIPTIONS = 256;
+			static constexpr uint32_t FRAMES_PER_PORT = 16;
+			static constexpr uint32_t DEFAULT_REFRESH_MS = 1000;
+
+			SoftSwitch();
+
+			/**
+			 * \brief adds a port.
+			 * \return the port number, or -1 if the switch already has MAX_PORTS ports
+			 */
+			int add_port(Transport& link);
+
+			uint8_t count() const {
+				return num_ports;
+			}
+
+			/**
+			 * \brief gives the switch an address of its own, which it answers pings on.
+			 * Bonded links to the switch can use it to check each link.
+			 */
+			void set_address(uint8_t addr);
+
+			/**
+			 * \brief sets how often ports are asked for their address lists.
+			 */
+			void set_refresh(uint32_t interval_ms) {
+				refresh_ms = interval_ms;
+			}
+
+			/**
+			 * \brief reads and forwards waiting frames on every port, then asks for address
+			 * lists if they are due. Call it whenever a port has input, or regularly.
+			 */
+			void service();
+
+			/**
+			 * \brief returns a bit for each port that an address is behind.
+			 */
+			uint32_t get_route(uint8_t addr) const {
+				return routes[addr];
+			}
+
+			SwitchPortStats get_port_stats(uint8_t port) const;
+
+		private:
+			struct Port
+			{
+				FramePort port;
+				bool down = false;
+				uint8_t addrs[32];
+				uint32_t last_heard = 0;
+				uint32_t no_route = 0;
+				uint32_t ttl_expired = 0;
+			};
+
+			struct Subscription
+			{
+				uint8_t port;
+				uint8_t dg_port;
+				uint8_t addr;
+			};
+
+			void forward(uint8_t in, uint8_t* frame, uint32_t len);
+			void send_to(uint32_t mask, const uint8_t* frame, uint32_t len);
+			void answer_addr_list(uint8_t in);
+			void answer_ping(uint8_t in, const uint8_t* frame);
+			void subscribe(uint8_t in, uint8_t* frame, uint32_t len);
+			void refresh();
+			void drop_port(uint8_t i);
+			void rebuild_routes();
+			void rebuild_multicast();
+
+			Port ports[MAX_PORTS];
+			uint8_t num_ports = 0;
+
+			uint32_t routes[256];
+			uint32_t multicast[256];
+
+			Subscription subs[MAX_SUBSCRIPTIONS];
+			uint32_t num_subs = 0;
+
+			bool has_address = false;
+			uint8_t address = 0;
+			uint32_t refresh_ms = DEFAULT_REFRESH_MS;
+			uint32_t last_refresh = 0;
+	};
+
+}
+
+#endif
+
+#endif
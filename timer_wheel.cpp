@@ -0,0 +1,196 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "timer_wheel.h"
+#include "ulan_time.h"
+
+namespace picolan
+{
+
+constexpr uint32_t TimerWheel::BITS;
+constexpr uint32_t TimerWheel::SLOTS;
+constexpr uint32_t TimerWheel::LEVELS;
+
+Timer::~Timer()
+{
+	cancel();
+}
+
+void Timer::cancel()
+{
+	if(wheel != nullptr) {
+		wheel->cancel(*this);
+	}
+}
+
+TimerWheel::TimerWheel()
+{
+	for(uint32_t l = 0; l < LEVELS; l++) {
+		for(uint32_t i = 0; i < SLOTS; i++) {
+			slots[l][i] = nullptr;
+		}
+	}
+	current = now_ms();
+}
+
+void TimerWheel::schedule(Timer& t, uint32_t delay_ms)
+{
+	schedule_at(t, now_ms() + delay_ms);
+}
+
+void TimerWheel::schedule_at(Timer& t, uint32_t deadline)
+{
+	if(t.wheel != nullptr) {
+		t.wheel->cancel(t);
+	}
+
+	t.deadline = deadline;
+	t.wheel = this;
+	count++;
+	place(t);
+}
+
+void TimerWheel::cancel(Timer& t)
+{
+	if(t.wheel != this) {
+		return;
+	}
+	unlink(t);
+	t.wheel = nullptr;
+	count--;
+}
+
+void TimerWheel::advance()
+{
+	advance(now_ms());
+}
+
+void TimerWheel::advance(uint32_t now)
+{
+	while((int32_t)(now - current) >= 0) {
+		if(count == 0) {
+			current = now+1;
+			return;
+		}
+
+		uint32_t index = current & (SLOTS-1);
+		if(index == 0) {
+			cascade(1);
+		}
+
+		// take the whole slot first, so timers scheduled by callbacks wait for the next tick
+		Timer* t = slots[0][index];
+		slots[0][index] = nullptr;
+		if(t != nullptr) {
+			t->prev = nullptr;
+		}
+		current++;
+
+		while(t != nullptr) {
+			Timer* next = t->next;
+			t->next = nullptr;
+			t->slot = nullptr;
+			t->wheel = nullptr;
+			count--;
+			if(t->callback != nullptr) {
+				t->callback(t->context);
+			}
+			t = next;
+		}
+	}
+}
+
+void TimerWheel::place(Timer& t)
+{
+	int32_t delta = (int32_t)(t.deadline - current);
+	uint32_t level = 0;
+	uint32_t when = t.deadline;
+
+	if(delta < 0) {
+		when = current;
+	} else {
+		while((level < LEVELS-1) && ((uint32_t)delta >= (1u << (BITS*(level+1))))) {
+			level++;
+		}
+
+		// beyond the range of the wheel, park in the furthest top level slot.
+		// the timer is placed again when that slot is cascaded.
+		if(BITS*LEVELS < 32) {
+			uint32_t range = 1u << ((BITS*LEVELS) % 32);
+			if((uint32_t)delta >= range) {
+				when = current + range - 1;
+			}
+		}
+	}
+
+	uint32_t index = (when >> (BITS*level)) & (SLOTS-1);
+	Timer** head = &slots[level][index];
+	t.slot = head;
+	t.prev = nullptr;
+	t.next = *head;
+	if(*head != nullptr) {
+		(*head)->prev = &t;
+	}
+	*head = &t;
+}
+
+void TimerWheel::cascade(uint32_t level)
+{
+	if(level >= LEVELS) {
+		return;
+	}
+
+	uint32_t index = (current >> (BITS*level)) & (SLOTS-1);
+	if(index == 0) {
+		cascade(level+1);
+	}
+
+	Timer* t = slots[level][index];
+	slots[level][index] = nullptr;
+	while(t != nullptr) {
+		Timer* next = t->next;
+		place(*t);
+		t = next;
+	}
+}
+
+void TimerWheel::unlink(Timer& t)
+{
+	if(t.prev != nullptr) {
+		t.prev->next = t.next;
+	} else if(t.slot != nullptr) {
+		*t.slot = t.next;
+	}
+	if(t.next != nullptr) {
+		t.next->prev = t.prev;
+	}
+	t.next = nullptr;
+	t.prev = nullptr;
+	t.slot = nullptr;
+}
+
+}
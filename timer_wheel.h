@@ -0,0 +1,167 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_TIMER_WHEEL_H
+#define PICOLAN_TIMER_WHEEL_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "config.h"
+
+namespace picolan
+{
+
+	class TimerWheel;
+
+	/**
+	 * Timer is a deadline tracked by a TimerWheel.
+	 * The timer is linked directly into the wheel, so scheduling and cancelling it
+	 * don't allocate memory and take constant time. When the deadline passes the callback
+	 * is called from TimerWheel::advance(), which Interface::service() calls.
+	 */
+	class Timer
+	{
+		public:
+			typedef void (*Callback)(void* context);
+
+			Timer() { }
+			Timer(Callback cb, void* context) : callback(cb), context(context) { }
+
+			/**
+			 * \brief a timer cancels itself when it is destroyed.
+			 */
+			~Timer();
+
+			Timer(const Timer&) = delete;
+			Timer& operator=(const Timer&) = delete;
+
+			void set_callback(Callback cb, void* ctx) {
+				callback = cb;
+				context = ctx;
+			}
+
+			/**
+			 * \brief cancels the timer if it is scheduled.
+			 */
+			void cancel();
+
+			/**
+			 * \brief returns true if the timer is scheduled and hasn't expired yet.
+			 */
+			bool active() const {
+				return wheel != nullptr;
+			}
+
+			/**
+			 * \brief the time in milliseconds when the timer expires.
+			 */
+			uint32_t get_deadline() const {
+				return deadline;
+			}
+
+		private:
+			friend class TimerWheel;
+
+			Callback callback = nullptr;
+			void* context = nullptr;
+			uint32_t deadline = 0;
+
+			TimerWheel* wheel = nullptr;
+			Timer** slot = nullptr;
+			Timer* next = nullptr;
+			Timer* prev = nullptr;
+	};
+
+	/**
+	 * TimerWheel is a hierarchical timing wheel with one millisecond ticks.
+	 * Level 0 holds timers due within the next 2^BITS milliseconds, one slot per millisecond.
+	 * Each higher level has slots 2^BITS times coarser, and its timers are moved down a level
+	 * as their slot comes up. Scheduling and cancelling take constant time however many timers
+	 * there are, and advancing an empty wheel costs nothing.
+	 */
+	class TimerWheel
+	{
+		public:
+			// see Config::TIMER_WHEEL_BITS
+			static constexpr uint32_t BITS = Config::TIMER_WHEEL_BITS;
+			static constexpr uint32_t SLOTS = (1u << BITS);
+			static constexpr uint32_t LEVELS = 4;
+
+			TimerWheel();
+
+			/**
+			 * \brief schedules a timer to expire after a delay. A timer that is already
+			 * scheduled is moved to the new deadline.
+			 * @param delay_ms the delay in milliseconds
+			 */
+			void schedule(Timer& t, uint32_t delay_ms);
+
+			/**
+			 * \brief schedules a timer to expire at a time in milliseconds, as returned by now_ms().
+			 * A deadline that has already passed expires the next time the wheel is advanced.
+			 */
+			void schedule_at(Timer& t, uint32_t deadline);
+
+			/**
+			 * \brief cancels a timer. Nothing happens if the timer isn't scheduled.
+			 */
+			void cancel(Timer& t);
+
+			/**
+			 * \brief runs the callback of every timer that has expired by now.
+			 */
+			void advance();
+
+			/**
+			 * \brief runs the callback of every timer that has expired by the time given in milliseconds.
+			 */
+			void advance(uint32_t now);
+
+			/**
+			 * \brief returns the number of scheduled timers.
+			 */
+			uint32_t size() const {
+				return count;
+			}
+
+		private:
+			void place(Timer& t);
+			void cascade(uint32_t level);
+			void unlink(Timer& t);
+
+			Timer* slots[LEVELS][SLOTS];
+			uint32_t current;
+			uint32_t count = 0;
+	};
+
+}
+
+#endif
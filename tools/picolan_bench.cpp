@@ -0,0 +1,58 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+// Runs the transport benchmark and writes the results as JSON.
+//
+//   picolan_bench <output.json> [label]
+//
+// The label identifies the run in the results, such as a commit hash. To build it on Linux,
+// compile this with the PicoLAN sources (and etk) on the include path:
+//
+//   g++ -std=c++14 -O2 -I<etk> -I.. -o picolan_bench picolan_bench.cpp ../*.cpp -pthread
+
+#include "../benchmark.h"
+
+#if !defined(__linux__) || defined(PICOLAN_NODE_BINDING)
+#error "the benchmark runs on Linux and isn't part of the node binding"
+#endif
+
+#include <stdio.h>
+
+using namespace picolan;
+
+int main(int argc, char** argv)
+{
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s <output.json> [label]\n", argv[0]);
+		return 2;
+	}
+
+	Benchmark bench;
+	if(!bench.write(argv[1], (argc > 2) ? argv[2] : "")) {
+		fprintf(stderr, "%s: can't write %s\n", argv[0], argv[1]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "topology.h"
+#include "ulan_time.h"
+
+namespace picolan
+{
+
+constexpr uint8_t TopologyCache::NUM_BYTES;
+
+TopologyCache::TopologyCache()
+{
+	for(uint8_t i = 0; i < NUM_BYTES; i++) {
+		bytes[i] = 0;
+	}
+}
+
+uint16_t TopologyCache::update(AddressField& field)
+{
+	uint16_t changed = 0;
+	for(uint8_t i = 0; i < NUM_BYTES; i++) {
+		uint8_t b = field.get_bitfield(i).get();
+		uint8_t diff = bytes[i] ^ b;
+		if(diff == 0) {
+			continue;
+		}
+
+		bytes[i] = b;
+		for(uint8_t bit = 0; bit < 8; bit++) {
+			if((diff >> bit) & 1) {
+				bool now = (b >> bit) & 1;
+				if(now) {
+					num_present++;
+				} else {
+					num_present--;
+				}
+				changed++;
+				if(callback != nullptr) {
+					callback(callback_context, i*8 + bit, now);
+				}
+			}
+		}
+	}
+
+	updates++;
+	updated_at = now_ms();
+	return changed;
+}
+
+int TopologyCache::next(int from) const
+{
+	if((from < 0) || (from > 255)) {
+		return -1;
+	}
+
+	uint8_t i = from/8;
+	uint8_t b = bytes[i] & (0xFF << (from%8));
+	while(true) {
+		if(b != 0) {
+			uint8_t bit = 0;
+			while(((b >> bit) & 1) == 0) {
+				bit++;
+			}
+			return i*8 + bit;
+		}
+		if(++i == NUM_BYTES) {
+			return -1;
+		}
+		b = bytes[i];
+	}
+}
+
+uint32_t TopologyCache::age_ms() const
+{
+	return now_ms() - updated_at;
+}
+
+}
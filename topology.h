@@ -0,0 +1,137 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_TOPOLOGY_H
+#define PICOLAN_TOPOLOGY_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "address_field.h"
+
+namespace picolan
+{
+
+	/**
+	 * TopologyCache holds the last list of addresses reported by the switch.
+	 * Each new list is compared with the cached one a byte at a time, and only the
+	 * addresses that changed are updated and reported to the change callback.
+	 * Lookups answer from the cache without touching the network.
+	 *
+	 * To visit every present address:
+	 * \code
+	 * for(int a = cache.first(); a >= 0; a = cache.next(a+1)) {
+	 *     ...
+	 * }
+	 * \endcode
+	 */
+	class TopologyCache
+	{
+		public:
+			typedef void (*ChangeCallback)(void* context, uint8_t addr, bool present);
+
+			static constexpr uint8_t NUM_BYTES = 32;
+
+			TopologyCache();
+
+			/**
+			 * \brief sets a function that is called for each address that appears or disappears.
+			 * Pass nullptr to remove it.
+			 */
+			void set_change_callback(ChangeCallback cb, void* context) {
+				callback = cb;
+				callback_context = context;
+			}
+
+			/**
+			 * \brief applies a new address list from the switch.
+			 * \return the number of addresses that changed
+			 */
+			uint16_t update(AddressField& field);
+
+			/**
+			 * \brief returns true if the address was in the last list.
+			 */
+			bool present(uint8_t addr) const {
+				return (bytes[addr/8] >> (addr%8)) & 1;
+			}
+
+			/**
+			 * \brief returns the number of addresses present.
+			 */
+			uint16_t count() const {
+				return num_present;
+			}
+
+			/**
+			 * \brief returns the lowest present address, or -1 if there are none.
+			 */
+			int first() const {
+				return next(0);
+			}
+
+			/**
+			 * \brief returns the lowest present address that is at least from, or -1 if there are none.
+			 * Empty bytes of the table are skipped whole.
+			 */
+			int next(int from) const;
+
+			/**
+			 * \brief returns true once a list has been received.
+			 */
+			bool valid() const {
+				return updates != 0;
+			}
+
+			/**
+			 * \brief returns the number of lists received.
+			 */
+			uint32_t get_updates() const {
+				return updates;
+			}
+
+			/**
+			 * \brief returns the number of milliseconds since the last list was received.
+			 */
+			uint32_t age_ms() const;
+
+		private:
+			uint8_t bytes[NUM_BYTES];
+			uint16_t num_present = 0;
+			uint32_t updates = 0;
+			uint32_t updated_at = 0;
+
+			ChangeCallback callback = nullptr;
+			void* callback_context = nullptr;
+	};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_TRANSPORT_H
+#define PICOLAN_TRANSPORT_H
+
+#ifndef ARDUINO
+
+#include <stdint.h>
+
+namespace picolan
+{
+
+	/**
+	 * Transport is how an Interface on a host reaches the network.
+	 * A transport moves bytes in blocks and never waits when reading, so one thread can
+	 * service many interfaces. Transports that are backed by a file descriptor return it from
+	 * get_fd() so it can be watched with poll() or epoll.
+	 *
+	 * Byte stream transports, like a serial port, carry frames with start, end and escape bytes.
+	 * Transports that keep message boundaries, like UDP, return true from is_framed(). Each read()
+	 * and write() then carries exactly one frame with no framing bytes at all.
+	 */
+	class Transport
+	{
+		public:
+			virtual ~Transport() { }
+
+			/**
+			 * \brief reads up to len bytes without waiting.
+			 * \return the number of bytes read, zero if none are waiting or Error::IO
+			 */
+			virtual int read(uint8_t* buffer, uint32_t len) = 0;
+
+			/**
+			 * \brief writes len bytes, waiting if the transport can't take them all yet.
+			 * \return the number of bytes written or Error::IO
+			 */
+			virtual int write(const uint8_t* buffer, uint32_t len) = 0;
+
+			/**
+			 * \brief returns the number of bytes that can be read without waiting.
+			 */
+			virtual uint32_t available() = 0;
+
+			/**
+			 * \brief pushes out anything the transport has buffered.
+			 */
+			virtual void flush() { }
+
+			/**
+			 * \brief returns true if each read() and write() carries one whole frame.
+			 */
+			virtual bool is_framed() const {
+				return false;
+			}
+
+			/**
+			 * \brief returns the file descriptor to wait on for input, or -1 if there isn't one.
+			 */
+			virtual int get_fd() const {
+				return -1;
+			}
+	};
+
+
+	/**
+	 * StreamTransport adapts a byte at a time serial driver, with available(), get(), put()
+	 * and flush() like the usart_driver Serial class, to a Transport.
+	 */
+	template <typename STREAM_T> class StreamTransport : public Transport
+	{
+		public:
+			StreamTransport(STREAM_T& stream) : stream(stream) { }
+
+			int read(uint8_t* buffer, uint32_t len) {
+				uint32_t n = stream.available();
+				if(n > len) {
+					n = len;
+				}
+				for(uint32_t i = 0; i < n; i++) {
+					buffer[i] = stream.get();
+				}
+				return n;
+			}
+
+			int write(const uint8_t* buffer, uint32_t len) {
+				for(uint32_t i = 0; i < len; i++) {
+					stream.put(buffer[i]);
+				}
+				return len;
+			}
+
+			uint32_t available() {
+				return stream.available();
+			}
+
+			void flush() {
+				stream.flush();
+			}
+
+		private:
+			STREAM_T& stream;
+	};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef PICOLAN_TX_QUEUE_H
+#define PICOLAN_TX_QUEUE_H
+
+#ifdef ARDUINO
+#include <etk.h>
+#else
+#include <etk/etk.h>
+#endif
+
+#include "serialiser.h"
+
+namespace picolan
+{
+
+/**
+ * TxQueue holds outgoing frames in one queue per priority class and decides which frame is sent next.
+ * Frames are stored as a length byte followed by the frame in a ring per class, so no memory is
+ * allocated and small frames don't waste a whole slot. The storage is provided by the caller.
+ */
+class TxQueue
+{
+public:
+	enum POLICY : uint8_t
+	{
+		/** the highest priority frame waiting is always sent first */
+		STRICT,
+		/** classes take turns, each sending up to its weight in frames per turn */
+		WEIGHTED
+	};
+
+	TxQueue() {
+		for(uint8_t i = 0; i < NUM_PRIORITIES; i++) {
+			rings[i] = Ring();
+			weights[i] = 1;
+		}
+		weights[PRIORITY_CONTROL] = 4;
+		weights[PRIORITY_DATAGRAM] = 2;
+	}
+
+	/**
+	 * \brief gives the queue its storage, which is divided equally between the priority classes.
+	 * Any frames that were queued are discarded, so drain the queue first.
+	 * \return false if the buffer can't hold at least one frame per class. The queue is disabled.
+	 */
+	bool set_buffer(uint8_t* buffer, uint32_t len) {
+		uint32_t sz = len/NUM_PRIORITIES;
+		if((buffer == nullptr) || (sz < (MAX_FRAME_LENGTH+1u))) {
+			for(uint8_t i = 0; i < NUM_PRIORITIES; i++) {
+				rings[i] = Ring();
+			}
+			return false;
+		}
+		for(uint8_t i = 0; i < NUM_PRIORITIES; i++) {
+			rings[i] = Ring();
+			rings[i].buf = &buffer[i*sz];
+			rings[i].size = sz;
+		}
+		turn = 0;
+		credit = weights[0];
+		return true;
+	}
+
+	/**
+	 * \brief returns true if the queue has storage.
+	 */
+	bool enabled() const {
+		return rings[0].buf != nullptr;
+	}
+
+	void set_policy(uint8_t p) {
+		policy = p;
+	}
+
+	/**
+	 * \brief sets the number of frames each class may send per turn in WEIGHTED mode.
+	 * A weight of zero is treated as one so that no class is starved.
+	 */
+	void set_weights(uint8_t control, uint8_t datagram, uint8_t bulk) {
+		weights[PRIORITY_CONTROL] = control ? control : 1;
+		weights[PRIORITY_DATAGRAM] = datagram ? datagram : 1;
+		weights[PRIORITY_BULK] = bulk ? bulk : 1;
+		credit = weights[turn];
+	}
+
+	/**
+	 * \brief queues a frame.
+	 * \return false if there isn't room in the queue for this class.
+	 */
+	bool push(uint8_t prio, const uint8_t* frame, uint8_t len) {
+		if(prio >= NUM_PRIORITIES) {
+			prio = PRIORITY_BULK;
+		}
+		Ring& r = rings[prio];
+		if((r.used + len + 1u) > r.size) {
+			return false;
+		}
+		r.put(len);
+		for(uint8_t i = 0; i < len; i++) {
+			r.put(frame[i]);
+		}
+		return true;
+	}
+
+	/**
+	 * \brief removes the next frame to send according to the policy.
+	 * @param frame a buffer of at least MAX_FRAME_LENGTH bytes
+	 * \return the length of the frame, or zero if the queue is empty.
+	 */
+	uint8_t pop(uint8_t* frame) {
+		int c = next_class(true);
+		if(c < 0) {
+			return 0;
+		}
+		Ring& r = rings[c];
+		uint8_t len = r.get();
+		for(uint8_t i = 0; i < len; i++) {
+			frame[i] = r.get();
+		}
+		return len;
+	}
+
+	/**
+	 * \brief copies the frame that pop() would return next without removing it.
+	 * @param frame a buffer of at least MAX_FRAME_LENGTH bytes
+	 * \return the length of the frame, or zero if the queue is empty.
+	 */
+	uint8_t peek(uint8_t* frame) {
+		int c = next_class(false);
+		if(c < 0) {
+			return 0;
+		}
+		const Ring& r = rings[c];
+		uint8_t len = r.at(0);
+		for(uint8_t i = 0; i < len; i++) {
+			frame[i] = r.at(i+1);
+		}
+		return len;
+	}
+
+	bool empty() const {
+		for(uint8_t i = 0; i < NUM_PRIORITIES; i++) {
+			if(rings[i].used != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	struct Ring
+	{
+		uint8_t* buf = nullptr;
+		uint32_t size = 0;
+		uint32_t head = 0;
+		uint32_t used = 0;
+
+		void put(uint8_t b) {
+			buf[(head + used) % size] = b;
+			used++;
+		}
+
+		uint8_t at(uint32_t i) const {
+			return buf[(head + i) % size];
+		}
+
+		uint8_t get() {
+			uint8_t b = buf[head];
+			head = (head+1) % size;
+			used--;
+			return b;
+		}
+	};
+
+	// take is false when peeking, so the turn can move on but no credit is spent
+	int next_class(bool take) {
+		if(policy == STRICT) {
+			for(uint8_t i = 0; i < NUM_PRIORITIES; i++) {
+				if(rings[i].used != 0) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		// a class that has nothing to send gives up the rest of its turn
+		for(uint8_t n = 0; n <= NUM_PRIORITIES; n++) {
+			if((rings[turn].used != 0) && (credit != 0)) {
+				if(take) {
+					credit--;
+				}
+				return turn;
+			}
+			turn = (turn+1) % NUM_PRIORITIES;
+			credit = weights[turn];
+		}
+		return -1;
+	}
+
+	Ring rings[NUM_PRIORITIES];
+	uint8_t weights[NUM_PRIORITIES];
+	uint8_t policy = STRICT;
+	uint8_t turn = 0;
+	uint8_t credit = 0;
+};
+
+}
+
+#endif
@@ -1,17 +1,152 @@
 #ifndef PICOLAN_TIME_H
 #define PICOLAN_TIME_H
 
-#ifndef ARDUINO
+#include <stdint.h>
 
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
 #include <chrono>
 #include <thread>
-using namespace std::chrono;
+#endif
+
+namespace picolan
+{
+
+	/**
+	 * TimeSource is where the library gets the time from.
+	 * The time must be monotonic, so it never goes backwards when the wall clock is adjusted.
+	 * See set_time_source().
+	 */
+	class TimeSource
+	{
+		public:
+			virtual ~TimeSource() { }
+
+			/**
+			 * \brief returns the time in microseconds since an arbitrary starting point.
+			 */
+			virtual uint64_t now_us() = 0;
+	};
+
+	/**
+	 * MonotonicClock is the default time source. On a host it uses std::chrono::steady_clock.
+	 * On Arduino it extends micros() to 64 bits, so it must be read at least once every
+	 * 71 minutes, which servicing the interface does.
+	 */
+	class MonotonicClock : public TimeSource
+	{
+		public:
+			uint64_t now_us()
+			{
+				#ifdef ARDUINO
+				uint32_t t = ::micros();
+				if(t < last) {
+					high += (1ULL << 32);
+				}
+				last = t;
+				return high + t;
+				#else
+				using namespace std::chrono;
+				return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+				#endif
+			}
+
+		private:
+			#ifdef ARDUINO
+			uint32_t last = 0;
+			uint64_t high = 0;
+			#endif
+	};
+
+	/**
+	 * VirtualClock is a time source that only moves when it is told to.
+	 * Simulations and benchmarks use it to run deterministically and faster than real time.
+	 * Install it with set_time_source() before creating interfaces, because timers
+	 * take their starting point from the clock.
+	 */
+	class VirtualClock : public TimeSource
+	{
+		public:
+			uint64_t now_us()
+			{
+				return now;
+			}
+
+			void set_us(uint64_t us)
+			{
+				now = us;
+			}
+
+			void advance_us(uint64_t us)
+			{
+				now += us;
+			}
+
+			void advance_ms(uint32_t ms)
+			{
+				now += (uint64_t)ms*1000;
+			}
+
+		private:
+			uint64_t now = 0;
+	};
 
-inline auto millis() {
-	milliseconds ms = duration_cast< milliseconds >(
-			system_clock::now().time_since_epoch()
-			);
-	return ms.count();
+	inline TimeSource*& time_source_ptr()
+	{
+		static TimeSource* source = nullptr;
+		return source;
+	}
+
+	/**
+	 * \brief returns the time source the library is using.
+	 */
+	inline TimeSource& get_time_source()
+	{
+		static MonotonicClock monotonic;
+		TimeSource* s = time_source_ptr();
+		if(s == nullptr) {
+			return monotonic;
+		}
+		return *s;
+	}
+
+	/**
+	 * \brief replaces the time source for the whole library.
+	 * @param source the new time source, or nullptr to return to the monotonic clock
+	 */
+	inline void set_time_source(TimeSource* source)
+	{
+		time_source_ptr() = source;
+	}
+
+	/**
+	 * \brief returns the time in microseconds from the library time source.
+	 */
+	inline uint64_t now_us()
+	{
+		return get_time_source().now_us();
+	}
+
+	/**
+	 * \brief returns the time in milliseconds from the library time source.
+	 * Like millis() this wraps after 49 days, so compare times by subtraction.
+	 */
+	inline uint32_t now_ms()
+	{
+		return (uint32_t)(now_us()/1000);
+	}
+
+}
+
+#ifndef ARDUINO
+
+inline int64_t millis() {
+	return (int64_t)(picolan::now_us()/1000);
+}
+
+inline int64_t micros() {
+	return (int64_t)picolan::now_us();
 }
 
 inline void delay(uint32_t ms) {
@@ -21,4 +156,3 @@ inline void delay(uint32_t ms) {
 #endif
 
 #endif
-
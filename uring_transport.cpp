@@ -0,0 +1,523 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#include "uring_transport.h"
+
+#if defined(__linux__) && defined(PICOLAN_IO_URING)
+
+#include "picolan.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+namespace picolan
+{
+
+constexpr uint32_t UringLoop::MAX_PORTS;
+constexpr uint32_t UringLoop::RX_BUFFER;
+constexpr uint32_t UringLoop::TX_BUFFER;
+
+namespace
+{
+
+// user_data holds the port index above the operation
+enum URING_OP : uint64_t
+{
+	OP_READ,
+	OP_WRITE,
+	OP_POLL
+};
+
+constexpr uint64_t TIMEOUT_TAG = ~0ULL;
+
+uint32_t load_acquire(const uint32_t* p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(uint32_t* p, uint32_t v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+}
+
+struct UringLoop::Ring
+{
+	int fd = -1;
+
+	void* sq_ptr = MAP_FAILED;
+	size_t sq_size = 0;
+	void* cq_ptr = MAP_FAILED;
+	size_t cq_size = 0;
+	io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqes_size = 0;
+
+	uint32_t* sq_head;
+	uint32_t* sq_tail;
+	uint32_t sq_mask;
+	uint32_t sq_entries;
+	uint32_t* sq_array;
+	uint32_t sq_local_tail;
+
+	uint32_t* cq_head;
+	uint32_t* cq_tail;
+	uint32_t cq_mask;
+	io_uring_cqe* cqes;
+
+	uint32_t queued = 0;
+	struct __kernel_timespec timeout;
+
+	~Ring() {
+		if(sqes != MAP_FAILED) {
+			munmap(sqes, sqes_size);
+		}
+		if((cq_ptr != MAP_FAILED) && (cq_ptr != sq_ptr)) {
+			munmap(cq_ptr, cq_size);
+		}
+		if(sq_ptr != MAP_FAILED) {
+			munmap(sq_ptr, sq_size);
+		}
+		if(fd >= 0) {
+			::close(fd);
+		}
+	}
+};
+
+UringLoop::~UringLoop()
+{
+	close();
+}
+
+int UringLoop::open(uint32_t entries)
+{
+	close();
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	Ring* r = new Ring();
+	r->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if(r->fd < 0) {
+		delete r;
+		return Error::IO;
+	}
+
+	r->sq_size = params.sq_off.array + params.sq_entries*sizeof(uint32_t);
+	r->cq_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		if(r->cq_size > r->sq_size) {
+			r->sq_size = r->cq_size;
+		}
+		r->cq_size = r->sq_size;
+	}
+
+	r->sq_ptr = mmap(nullptr, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if(r->sq_ptr == MAP_FAILED) {
+		delete r;
+		return Error::IO;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = r->sq_ptr;
+	} else {
+		r->cq_ptr = mmap(nullptr, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if(r->cq_ptr == MAP_FAILED) {
+			delete r;
+			return Error::IO;
+		}
+	}
+	r->sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+	r->sqes = (io_uring_sqe*)mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if(r->sqes == MAP_FAILED) {
+		delete r;
+		return Error::IO;
+	}
+
+	uint8_t* sq = (uint8_t*)r->sq_ptr;
+	r->sq_head = (uint32_t*)(sq + params.sq_off.head);
+	r->sq_tail = (uint32_t*)(sq + params.sq_off.tail);
+	r->sq_mask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+	r->sq_entries = params.sq_entries;
+	r->sq_array = (uint32_t*)(sq + params.sq_off.array);
+	r->sq_local_tail = *r->sq_tail;
+
+	uint8_t* cq = (uint8_t*)r->cq_ptr;
+	r->cq_head = (uint32_t*)(cq + params.cq_off.head);
+	r->cq_tail = (uint32_t*)(cq + params.cq_off.tail);
+	r->cq_mask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+	r->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	// registering pins the buffers so the kernel doesn't map them for every operation.
+	// It counts against the memory lock limit, so plain reads and writes are used if it fails.
+	struct iovec iov;
+	iov.iov_base = arena;
+	iov.iov_len = sizeof(arena);
+	fixed = (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+	ring = r;
+	return Error::NONE;
+}
+
+void UringLoop::close()
+{
+	delete ring;
+	ring = nullptr;
+	for(uint32_t i = 0; i < num_ports; i++) {
+		ports[i]->iface = nullptr;
+		ports[i]->read_posted = false;
+		ports[i]->write_posted = false;
+		ports[i]->error = true;
+	}
+	num_ports = 0;
+	fixed = false;
+	timeout_pending = false;
+}
+
+int UringLoop::add(UringTransport& port, Interface& iface)
+{
+	if((ring == nullptr) || (num_ports == MAX_PORTS) || (&port.loop != this)
+			|| !port.port.is_open() || port.port.is_framed()) {
+		return Error::IO;
+	}
+
+	port.index = num_ports;
+	port.iface = &iface;
+	port.rx = arena[num_ports];
+	port.tx[0] = port.rx + RX_BUFFER;
+	port.tx[1] = port.tx[0] + TX_BUFFER;
+	port.error = false;
+	ports[num_ports++] = &port;
+	post_read(port);
+	return Error::NONE;
+}
+
+int UringLoop::run_once(uint32_t timeout_ms)
+{
+	if(ring == nullptr) {
+		return Error::IO;
+	}
+
+	in_run = true;
+	prepare();
+	if((timeout_ms != 0) && !timeout_pending) {
+		io_uring_sqe* sqe = get_sqe();
+		ring->timeout.tv_sec = timeout_ms / 1000;
+		ring->timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		sqe->opcode = IORING_OP_TIMEOUT;
+		sqe->addr = (uint64_t)&ring->timeout;
+		sqe->len = 1;
+		sqe->user_data = TIMEOUT_TAG;
+		timeout_pending = true;
+	}
+	int r = submit(timeout_ms != 0);
+	reap();
+	dispatch();
+
+	// what the interfaces write while they are serviced is gathered and submitted together
+	for(uint32_t i = 0; i < num_ports; i++) {
+		if(ports[i]->iface != nullptr) {
+			ports[i]->iface->service();
+		}
+	}
+	prepare();
+	if(submit(0) != Error::NONE) {
+		r = Error::IO;
+	}
+	in_run = false;
+	return r;
+}
+
+io_uring_sqe* UringLoop::get_sqe()
+{
+	if((ring->sq_local_tail - load_acquire(ring->sq_head)) >= ring->sq_entries) {
+		submit(0);
+	}
+	uint32_t i = ring->sq_local_tail & ring->sq_mask;
+	io_uring_sqe* sqe = &ring->sqes[i];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[i] = i;
+	ring->sq_local_tail++;
+	ring->queued++;
+	return sqe;
+}
+
+int UringLoop::submit(uint32_t wait)
+{
+	store_release(ring->sq_tail, ring->sq_local_tail);
+	if((ring->queued == 0) && (wait == 0)) {
+		return Error::NONE;
+	}
+
+	unsigned flags = (wait != 0) ? IORING_ENTER_GETEVENTS : 0;
+	while(true) {
+		int r = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait, flags, nullptr, 0);
+		if(r >= 0) {
+			ring->queued -= ((uint32_t)r < ring->queued) ? r : ring->queued;
+			if(ring->queued == 0) {
+				return Error::NONE;
+			}
+			continue;
+		}
+		if(errno == EINTR) {
+			continue;
+		}
+		// the completion queue is full, so it has to be drained before more can be submitted
+		if(errno == EBUSY) {
+			reap();
+			continue;
+		}
+		return Error::IO;
+	}
+}
+
+void UringLoop::prepare()
+{
+	for(uint32_t i = 0; i < num_ports; i++) {
+		UringTransport& p = *ports[i];
+		if(p.error) {
+			continue;
+		}
+		if(!p.read_posted && (p.rx_pos == p.rx_len)) {
+			post_read(p);
+		}
+		if(!p.write_posted) {
+			post_write(p);
+		}
+	}
+}
+
+// reads are linked behind a poll, because the descriptor is non-blocking and a read
+// posted before data arrives would otherwise fail straight away
+void UringLoop::post_read(UringTransport& p)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = p.port.get_fd();
+	sqe->poll_events = POLLIN;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->user_data = ((uint64_t)p.index << 2) | OP_POLL;
+
+	sqe = get_sqe();
+	sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = p.port.get_fd();
+	sqe->addr = (uint64_t)p.rx;
+	sqe->len = UringLoop::RX_BUFFER;
+	sqe->off = (uint64_t)-1;
+	sqe->user_data = ((uint64_t)p.index << 2) | OP_READ;
+	p.rx_len = 0;
+	p.rx_pos = 0;
+	p.read_posted = true;
+}
+
+void UringLoop::post_write(UringTransport& p)
+{
+	uint8_t busy = p.tx_fill ^ 1;
+	if(p.tx_len[busy] == 0) {
+		if(p.tx_len[p.tx_fill] == 0) {
+			return;
+		}
+		busy = p.tx_fill;
+		p.tx_fill ^= 1;
+		p.tx_off = 0;
+	}
+
+	// a write only waits for room after the kernel buffer has been found to be full
+	if(p.write_poll) {
+		io_uring_sqe* sqe = get_sqe();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = p.port.get_fd();
+		sqe->poll_events = POLLOUT;
+		sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = ((uint64_t)p.index << 2) | OP_POLL;
+		p.write_poll = false;
+	}
+
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	sqe->fd = p.port.get_fd();
+	sqe->addr = (uint64_t)(p.tx[busy] + p.tx_off);
+	sqe->len = p.tx_len[busy] - p.tx_off;
+	sqe->off = (uint64_t)-1;
+	sqe->user_data = ((uint64_t)p.index << 2) | OP_WRITE;
+	p.write_posted = true;
+}
+
+void UringLoop::reap()
+{
+	uint32_t head = *ring->cq_head;
+	uint32_t tail = load_acquire(ring->cq_tail);
+	while(head != tail) {
+		const io_uring_cqe& cqe = ring->cqes[head & ring->cq_mask];
+		head++;
+
+		if(cqe.user_data == TIMEOUT_TAG) {
+			timeout_pending = false;
+			continue;
+		}
+		uint32_t index = cqe.user_data >> 2;
+		if(index >= num_ports) {
+			continue;
+		}
+		UringTransport& p = *ports[index];
+		int res = cqe.res;
+
+		switch(cqe.user_data & 3)
+		{
+			case OP_POLL:
+				// a failed poll cancels the operation linked to it, which is retried
+				// unless the descriptor itself is bad
+				if((res < 0) && (res != -ECANCELED) && (res != -EINTR)) {
+					p.error = true;
+				}
+				break;
+			case OP_READ:
+				p.read_posted = false;
+				if(res > 0) {
+					p.rx_len = res;
+				} else if((res == 0) || ((res != -EAGAIN) && (res != -EINTR) && (res != -ECANCELED))) {
+					p.error = true;
+				}
+				break;
+			case OP_WRITE:
+				{
+					p.write_posted = false;
+					uint8_t busy = p.tx_fill ^ 1;
+					if(res > 0) {
+						p.tx_off += res;
+						if(p.tx_off >= p.tx_len[busy]) {
+							p.tx_len[busy] = 0;
+							p.tx_off = 0;
+						}
+					} else if((res == -EAGAIN) || (res == -ECANCELED)) {
+						p.write_poll = true;
+					} else if(res != -EINTR) {
+						p.error = true;
+					}
+				}
+				break;
+		}
+	}
+	store_release(ring->cq_head, head);
+}
+
+void UringLoop::dispatch()
+{
+	for(uint32_t i = 0; i < num_ports; i++) {
+		UringTransport& p = *ports[i];
+		if((p.rx_pos != p.rx_len) && (p.iface != nullptr)) {
+			uint32_t n = p.rx_len - p.rx_pos;
+			p.rx_pos = p.rx_len;
+			p.iface->receive(p.rx + (p.rx_len - n), n);
+		}
+	}
+}
+
+bool UringLoop::wait_write(UringTransport& p)
+{
+	while(!p.error && (p.tx_len[p.tx_fill] == TX_BUFFER)) {
+		prepare();
+		if(submit(1) != Error::NONE) {
+			return false;
+		}
+		reap();
+	}
+	return !p.error;
+}
+
+void UringLoop::poll()
+{
+	prepare();
+	submit(0);
+	reap();
+}
+
+
+int UringTransport::read(uint8_t* buffer, uint32_t len)
+{
+	uint32_t n = rx_len - rx_pos;
+	if(n == 0) {
+		return error ? Error::IO : 0;
+	}
+	if(n > len) {
+		n = len;
+	}
+	memcpy(buffer, rx + rx_pos, n);
+	rx_pos += n;
+	return n;
+}
+
+int UringTransport::write(const uint8_t* buffer, uint32_t len)
+{
+	if(error || (iface == nullptr)) {
+		return Error::IO;
+	}
+
+	uint32_t done = 0;
+	while(done < len) {
+		uint32_t space = UringLoop::TX_BUFFER - tx_len[tx_fill];
+		if(space == 0) {
+			if(!loop.wait_write(*this)) {
+				return Error::IO;
+			}
+			continue;
+		}
+		uint32_t n = len - done;
+		if(n > space) {
+			n = space;
+		}
+		memcpy(tx[tx_fill] + tx_len[tx_fill], buffer + done, n);
+		tx_len[tx_fill] += n;
+		done += n;
+	}
+	return len;
+}
+
+uint32_t UringTransport::available()
+{
+	if((rx_pos == rx_len) && !loop.in_run && loop.is_open()) {
+		loop.poll();
+	}
+	return rx_len - rx_pos;
+}
+
+void UringTransport::flush()
+{
+	// inside run_once() writes are left for the loop to submit with everyone else's
+	if(!loop.in_run && loop.is_open()) {
+		loop.prepare();
+		loop.submit(0);
+	}
+}
+
+}
+
+#endif
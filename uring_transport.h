@@ -0,0 +1,183 @@
+/**
+
+  Copyright 2019 Samuel Cowen <samuel.cowen@camelsoftware.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+*/
+
+
+
+
+#ifndef PICOLAN_URING_TRANSPORT_H
+#define PICOLAN_URING_TRANSPORT_H
+
+#if defined(__linux__) && defined(PICOLAN_IO_URING)
+
+#include "fd_transport.h"
+
+struct io_uring_sqe;
+
+namespace picolan
+{
+
+	class Interface;
+	class UringTransport;
+
+	/**
+	 * UringLoop services many interfaces from one thread with io_uring, for gateways that
+	 * terminate many serial ports. A read is kept posted on every port, writes from all
+	 * interfaces are submitted together and completions are reaped in one place, so a pass
+	 * over every port costs a couple of system calls rather than several per port.
+	 * Completed reads go straight to the block decoder of the port's interface.
+	 *
+	 * The buffers are registered with the kernel when the memory lock limit allows it.
+	 * The loop is large because it holds them, so don't put it on the stack.
+	 *
+	 * Build with PICOLAN_IO_URING defined. No library is needed.
+	 */
+	class UringLoop
+	{
+		public:
+			static constexpr uint32_t MAX_PORTS = 32;
+			static constexpr uint32_t RX_BUFFER = 1024;
+			static constexpr uint32_t TX_BUFFER = 1024;
+
+			UringLoop() { }
+			~UringLoop();
+
+			UringLoop(const UringLoop&) = delete;
+			UringLoop& operator=(const UringLoop&) = delete;
+
+			/**
+			 * \brief sets up the ring.
+			 * @param entries the submission queue size
+			 * \return Error::NONE, or Error::IO if the kernel doesn't support io_uring
+			 */
+			int open(uint32_t entries = 256);
+
+			/**
+			 * \brief tears down the ring. Operations in flight are cancelled and every port is removed.
+			 */
+			void close();
+
+			bool is_open() const {
+				return ring != nullptr;
+			}
+
+			/**
+			 * \brief adds a port and the interface that uses it.
+			 * Only byte stream transports are supported, such as serial ports and TCP.
+			 * \return Error::NONE, or Error::IO if the loop is full, closed or the port isn't suitable
+			 */
+			int add(UringTransport& port, Interface& iface);
+
+			/**
+			 * \brief waits for I/O, parses what was received and services every interface,
+			 * then submits everything the interfaces wrote in one go.
+			 * @param timeout_ms the longest to wait for I/O. Zero doesn't wait.
+			 * \return Error::NONE or Error::IO
+			 */
+			int run_once(uint32_t timeout_ms);
+
+		private:
+			friend class UringTransport;
+			struct Ring;
+
+			io_uring_sqe* get_sqe();
+			void prepare();
+			int submit(uint32_t wait);
+			void reap();
+			void dispatch();
+			void post_read(UringTransport& p);
+			void post_write(UringTransport& p);
+			bool wait_write(UringTransport& p);
+			void poll();
+
+			Ring* ring = nullptr;
+			bool fixed = false;
+			bool in_run = false;
+			bool timeout_pending = false;
+			UringTransport* ports[MAX_PORTS];
+			uint32_t num_ports = 0;
+			uint8_t arena[MAX_PORTS][RX_BUFFER + 2*TX_BUFFER];
+	};
+
+
+	/**
+	 * UringTransport is a port serviced by a UringLoop. It wraps an open FdTransport, such as a
+	 * LinuxSerial, which keeps ownership of the descriptor. Give it to an Interface and then add
+	 * both to the loop.
+	 *
+	 * Writes are buffered until the loop submits them. If the buffer fills, write() waits for
+	 * the kernel to take some of it. Outside UringLoop::run_once(), such as when a blocking
+	 * socket call services the interface, the port submits and reaps for itself.
+	 */
+	class UringTransport : public Transport
+	{
+		public:
+			UringTransport(UringLoop& loop, FdTransport& port) : loop(loop), port(port) { }
+
+			UringTransport(const UringTransport&) = delete;
+			UringTransport& operator=(const UringTransport&) = delete;
+
+			int read(uint8_t* buffer, uint32_t len);
+			int write(const uint8_t* buffer, uint32_t len);
+			uint32_t available();
+			void flush();
+
+			int get_fd() const {
+				return port.get_fd();
+			}
+
+			/**
+			 * \brief returns true if the port has failed or the other end has gone away.
+			 */
+			bool failed() const {
+				return error;
+			}
+
+		private:
+			friend class UringLoop;
+
+			UringLoop& loop;
+			FdTransport& port;
+			Interface* iface = nullptr;
+			uint32_t index = 0;
+
+			uint8_t* rx = nullptr;
+			uint32_t rx_len = 0;
+			uint32_t rx_pos = 0;
+			bool read_posted = false;
+
+			uint8_t* tx[2] = {nullptr, nullptr};
+			uint32_t tx_len[2] = {0, 0};
+			uint32_t tx_off = 0;
+			uint8_t tx_fill = 0;
+			bool write_posted = false;
+			bool write_poll = false;
+
+			bool error = false;
+	};
+
+}
+
+#endif
+
+#endif